@@ -1,4 +1,7 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include "Math.h"
 
 namespace dae
@@ -15,13 +18,8 @@ namespace dae
 			return { cd * kd * DIV_PI };
 		}
 
-		static const ColorRGB Lambert(const ColorRGB& kd, const ColorRGB& cd)
-		{
-			return { cd * kd * DIV_PI };
-		}
-
 		/**
-		 * \brief todo
+		 * \brief Phong specular lobe, integerExponent selects the powf free variant for whole exponents
 		 * \param ks Specular Reflection Coefficient
 		 * \param exp Phong Exponent
 		 * \param l Incoming (incident) Light Direction
@@ -29,13 +27,16 @@ namespace dae
 		 * \param n Normal of the Surface
 		 * \return Phong Specular Color
 		 */
+		template<bool integerExponent = false>
 		static const ColorRGB Phong(const float ks, const float exp, const Vector3& l, const Vector3& v, const Vector3& n)
 		{
 			const float cosA{ Vector3::Dot(Vector3::Reflect(l, v), v) };
 
 			if (cosA < FLT_EPSILON) return {};
 
-			return { ks * powf(cosA, exp) };
+			// whole exponents (the usual case) don't need powf
+			if constexpr (integerExponent) return { ks * PowInteger(cosA, static_cast<unsigned int>(exp)) };
+			else return { ks * powf(cosA, exp) };
 		}
 
 		/**
@@ -55,22 +56,35 @@ namespace dae
 		}
 
 		/**
-		 * \brief BRDF NormalDistribution >> Trowbridge-Reitz GGX (UE4 implemetation - squared(roughness))
-		 * \param n Surface normal
-		 * \param h Normalized half vector
+		 * \brief Per material terms of the GGX and Smith functions, computed once when a material is created
 		 * \param roughness Roughness of the material
-		 * \return BRDF Normal Distribution Term using Trowbridge-Reitz GGX
+		 * \return a * a with a = squared(roughness) for GGX, k = squared(roughness + 1) / 8 for Smith (direct lighting)
 		 */
-		static const float NormalDistribution_GGX(const Vector3& n, const Vector3& h, const float roughness)
+		static const float GGX_AlphaSquared(const float roughness)
 		{
 			const float a{ roughness * roughness };
-			const float aa{  a * a };
+			return { a * a };
+		}
+
+		static const float Smith_K(const float roughness)
+		{
+			return { Square(Square(roughness) + 1) / 8.f };
+		}
 
+		/**
+		 * \brief BRDF NormalDistribution >> Trowbridge-Reitz GGX (UE4 implemetation - squared(roughness)) with the alpha term of the material
+		 * \param n Surface normal
+		 * \param h Normalized half vector
+		 * \param aa GGX_AlphaSquared(roughness)
+		 * \return BRDF Normal Distribution Term using Trowbridge-Reitz GGX
+		 */
+		static const float NormalDistribution_GGX(const Vector3& n, const Vector3& h, const float aa)
+		{
 			const float dot{ Vector3::Dot(n, h) };
 
 			if (dot < FLT_EPSILON) return {};
 
-			const float divider{ PI * powf((dot * dot * (aa - 1.f) + 1.f), 2.f) };
+			const float divider{ PI * Square(dot * dot * (aa - 1.f) + 1.f) };
 
 			return (aa / divider);
 		}
@@ -97,19 +111,274 @@ namespace dae
 		}
 
 		/**
-		 * \brief BRDF Geometry Function >> Smith (Direct Lighting)
+		 * \brief BRDF Geometry Function >> Smith (Direct Lighting) with the k term of the material
 		 * \param n Normal of the surface
 		 * \param v Normalized view direction
 		 * \param l Normalized light direction
-		 * \param roughness Roughness of the material
-		 * \return BRDF Geometry Term using Smith (> SchlickGGX(n,v,roughness) * SchlickGGX(n,l,roughness))
+		 * \param k Smith_K(roughness)
+		 * \return BRDF Geometry Term using Smith (> SchlickGGX(n,v,k) * SchlickGGX(n,l,k))
 		 */
-		static const float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, const float roughness)
+		static const float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, const float k)
 		{
-			const float k{ Square(Square(roughness) + 1) / 8.f };
-
 			return { GeometryFunction_SchlickGGX(n, v, k) * GeometryFunction_SchlickGGX(n, l, k) };
 		}
 
+		/**
+		 * \brief Cook-Torrance (Fresnel Schlick, GGX, Smith) from the per material terms, with a Lambert diffuse part for dielectrics
+		 * \param f0 Base reflectivity, the albedo for metals and 0.04 for dielectrics
+		 * \param diffuse albedo / PI, only used by dielectrics
+		 * \param aa GGX_AlphaSquared(roughness), roughness has to be > 0
+		 * \param k Smith_K(roughness)
+		 * \param n Normal of the surface
+		 * \param l Normalized light direction
+		 * \param v Normalized view direction
+		 * \return Cook-Torrance Color
+		 */
+		template<bool isMetal>
+		static const ColorRGB CookTorrence(const ColorRGB& f0, const ColorRGB& diffuse, const float aa, const float k, const Vector3& n, const Vector3& l, const Vector3& v)
+		{
+			const Vector3	h{ (v + l).Normalized() };
+
+			const ColorRGB	F{ FresnelFunction_Schlick(h, v, f0) };
+			const float		D{ NormalDistribution_GGX(n, h, aa) };
+			const float		G{ GeometryFunction_Smith(n, v, l, k) };
+
+			ColorRGB lambert{};
+			if constexpr (!isMetal)
+			{
+				lambert = diffuse * (1.f - F);
+			}
+
+			if (FloatIsZero(F.r) || FloatIsZero(D) || FloatIsZero(G)) return lambert;
+
+			const ColorRGB	DFG{ D * F * G };
+			const float vnln4{ 4.f * Vector3::Dot(v, n) * Vector3::Dot(l, n) };
+			const ColorRGB	specular{ DFG / vnln4 };
+
+			return { lambert + specular };
+		}
+
+#pragma region Batch BRDFs
+		// Up to shadingBatchSize (normal, light, view) tuples of hits that share a material, in SoA form
+		// The batch kernels work 4 lanes at a time, the lanes past count (up to the next multiple of 4) are evaluated too but never read back
+		constexpr uint32_t shadingBatchSize{ 64 };
+
+		struct ShadingBatch
+		{
+			alignas(16) float normalX[shadingBatchSize]{};
+			alignas(16) float normalY[shadingBatchSize]{};
+			alignas(16) float normalZ[shadingBatchSize]{};
+			alignas(16) float lightX[shadingBatchSize]{};
+			alignas(16) float lightY[shadingBatchSize]{};
+			alignas(16) float lightZ[shadingBatchSize]{};
+			alignas(16) float viewX[shadingBatchSize]{};
+			alignas(16) float viewY[shadingBatchSize]{};
+			alignas(16) float viewZ[shadingBatchSize]{};
+			uint32_t count{};
+
+			bool IsFull() const { return count == shadingBatchSize; }
+
+			// returns the lane of the added tuple
+			uint32_t Add(const Vector3& n, const Vector3& l, const Vector3& v)
+			{
+				assert(!IsFull());
+				normalX[count] = n.x;
+				normalY[count] = n.y;
+				normalZ[count] = n.z;
+				lightX[count] = l.x;
+				lightY[count] = l.y;
+				lightZ[count] = l.z;
+				viewX[count] = v.x;
+				viewY[count] = v.y;
+				viewZ[count] = v.z;
+				return count++;
+			}
+
+			Vector3 GetNormal(const uint32_t lane) const { return { normalX[lane], normalY[lane], normalZ[lane] }; }
+			Vector3 GetLight(const uint32_t lane) const { return { lightX[lane], lightY[lane], lightZ[lane] }; }
+			Vector3 GetView(const uint32_t lane) const { return { viewX[lane], viewY[lane], viewZ[lane] }; }
+		};
+
+		struct ColorBatch
+		{
+			alignas(16) float r[shadingBatchSize]{};
+			alignas(16) float g[shadingBatchSize]{};
+			alignas(16) float b[shadingBatchSize]{};
+
+			void Fill(const ColorRGB& color, const uint32_t count)
+			{
+				std::fill_n(r, count, color.r);
+				std::fill_n(g, count, color.g);
+				std::fill_n(b, count, color.b);
+			}
+
+			void Set(const uint32_t lane, const ColorRGB& color)
+			{
+				r[lane] = color.r;
+				g[lane] = color.g;
+				b[lane] = color.b;
+			}
+
+			ColorRGB Get(const uint32_t lane) const { return { r[lane], g[lane], b[lane] }; }
+		};
+
+#ifdef DAE_SIMD_SSE
+		inline __m128 Dot4(const __m128 x1, const __m128 y1, const __m128 z1, const __m128 x2, const __m128 y2, const __m128 z2)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, x2), _mm_mul_ps(y1, y2)), _mm_mul_ps(z1, z2));
+		}
+
+		// 0 for the lanes with dot < FLT_EPSILON, else dot / (dot * (1 - k) + k), see GeometryFunction_SchlickGGX
+		inline __m128 GeometryFunction_SchlickGGX4(const __m128 dot, const __m128 k)
+		{
+			const __m128 result{ _mm_div_ps(dot, _mm_add_ps(_mm_mul_ps(dot, _mm_sub_ps(_mm_set1_ps(1.f), k)), k)) };
+			return _mm_andnot_ps(_mm_cmplt_ps(dot, _mm_set1_ps(FLT_EPSILON)), result);
+		}
+
+		// FloatIsZero per lane
+		inline __m128 IsZero4(const __m128 value)
+		{
+			return _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), value), _mm_set1_ps(FLT_EPSILON));
+		}
+#endif
+
+		/**
+		 * \brief CookTorrence for every tuple of the batch, same terms (and order of operations) as the single sample version
+		 * \param colors receives the Cook-Torrance Color per lane
+		 */
+		template<bool isMetal>
+		static void CookTorrence_Batch(const ColorRGB& f0, const ColorRGB& diffuse, const float aa, const float k, const ShadingBatch& batch, ColorBatch& colors)
+		{
+#ifdef DAE_SIMD_SSE
+			const __m128 one{ _mm_set1_ps(1.f) };
+			const __m128 epsilon{ _mm_set1_ps(FLT_EPSILON) };
+			const __m128 f0Lanes[3]{ _mm_set1_ps(f0.r), _mm_set1_ps(f0.g), _mm_set1_ps(f0.b) };
+			const __m128 diffuseLanes[3]{ _mm_set1_ps(diffuse.r), _mm_set1_ps(diffuse.g), _mm_set1_ps(diffuse.b) };
+			const __m128 aaLanes{ _mm_set1_ps(aa) };
+			const __m128 aaMinusOne{ _mm_set1_ps(aa - 1.f) };
+			const __m128 kLanes{ _mm_set1_ps(k) };
+			float* const output[3]{ colors.r, colors.g, colors.b };
+
+			for (uint32_t idx{}; idx < batch.count; idx += 4)
+			{
+				const __m128 nx{ _mm_load_ps(&batch.normalX[idx]) }, ny{ _mm_load_ps(&batch.normalY[idx]) }, nz{ _mm_load_ps(&batch.normalZ[idx]) };
+				const __m128 lx{ _mm_load_ps(&batch.lightX[idx]) }, ly{ _mm_load_ps(&batch.lightY[idx]) }, lz{ _mm_load_ps(&batch.lightZ[idx]) };
+				const __m128 vx{ _mm_load_ps(&batch.viewX[idx]) }, vy{ _mm_load_ps(&batch.viewY[idx]) }, vz{ _mm_load_ps(&batch.viewZ[idx]) };
+
+				// half vector
+				__m128 hx{ _mm_add_ps(vx, lx) }, hy{ _mm_add_ps(vy, ly) }, hz{ _mm_add_ps(vz, lz) };
+				const __m128 invMagnitude{ _mm_div_ps(one, _mm_sqrt_ps(Dot4(hx, hy, hz, hx, hy, hz))) };
+				hx = _mm_mul_ps(hx, invMagnitude);
+				hy = _mm_mul_ps(hy, invMagnitude);
+				hz = _mm_mul_ps(hz, invMagnitude);
+
+				// Fresnel (Schlick)
+				const __m128 temp{ _mm_sub_ps(one, Dot4(hx, hy, hz, vx, vy, vz)) };
+				const __m128 tempSquared{ _mm_mul_ps(temp, temp) };
+				const __m128 tempPow5{ _mm_mul_ps(_mm_mul_ps(temp, tempSquared), tempSquared) };
+
+				// Normal distribution (GGX)
+				const __m128 dotNH{ Dot4(nx, ny, nz, hx, hy, hz) };
+				const __m128 base{ _mm_add_ps(_mm_mul_ps(_mm_mul_ps(dotNH, dotNH), aaMinusOne), one) };
+				__m128 D{ _mm_div_ps(aaLanes, _mm_mul_ps(_mm_set1_ps(PI), _mm_mul_ps(base, base))) };
+				D = _mm_andnot_ps(_mm_cmplt_ps(dotNH, epsilon), D);
+
+				// Geometry (Smith)
+				const __m128 dotNV{ Dot4(nx, ny, nz, vx, vy, vz) };
+				const __m128 dotNL{ Dot4(nx, ny, nz, lx, ly, lz) };
+				const __m128 G{ _mm_mul_ps(GeometryFunction_SchlickGGX4(dotNV, kLanes), GeometryFunction_SchlickGGX4(dotNL, kLanes)) };
+
+				const __m128 vnln4{ _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.f), Dot4(vx, vy, vz, nx, ny, nz)), Dot4(lx, ly, lz, nx, ny, nz)) };
+
+				__m128 F[3];
+				for (int channel{}; channel < 3; ++channel)
+				{
+					F[channel] = _mm_add_ps(f0Lanes[channel], _mm_mul_ps(_mm_sub_ps(one, f0Lanes[channel]), tempPow5));
+				}
+
+				// no specular part where one of the terms is zero
+				const __m128 isSpecularZero{ _mm_or_ps(_mm_or_ps(IsZero4(F[0]), IsZero4(D)), IsZero4(G)) };
+
+				for (int channel{}; channel < 3; ++channel)
+				{
+					__m128 lambert{ _mm_setzero_ps() };
+					if constexpr (!isMetal) lambert = _mm_mul_ps(diffuseLanes[channel], _mm_sub_ps(one, F[channel]));
+
+					const __m128 specular{ _mm_div_ps(_mm_mul_ps(_mm_mul_ps(F[channel], D), G), vnln4) };
+					_mm_store_ps(&output[channel][idx], _mm_add_ps(lambert, _mm_andnot_ps(isSpecularZero, specular)));
+				}
+			}
+#else
+			for (uint32_t lane{}; lane < batch.count; ++lane)
+			{
+				colors.Set(lane, CookTorrence<isMetal>(f0, diffuse, aa, k, batch.GetNormal(lane), batch.GetLight(lane), batch.GetView(lane)));
+			}
+#endif
+		}
+
+		/**
+		 * \brief Lambert + Phong for every tuple of the batch, see Lambert and Phong
+		 * \param colors receives the Lambert-Phong Color per lane
+		 */
+		template<bool integerExponent>
+		static void LambertPhong_Batch(const ColorRGB& diffuse, const float ks, const float exp, const ShadingBatch& batch, ColorBatch& colors)
+		{
+#ifdef DAE_SIMD_SSE
+			alignas(16) float specular[shadingBatchSize];
+
+			for (uint32_t idx{}; idx < batch.count; idx += 4)
+			{
+				const __m128 lx{ _mm_load_ps(&batch.lightX[idx]) }, ly{ _mm_load_ps(&batch.lightY[idx]) }, lz{ _mm_load_ps(&batch.lightZ[idx]) };
+				const __m128 vx{ _mm_load_ps(&batch.viewX[idx]) }, vy{ _mm_load_ps(&batch.viewY[idx]) }, vz{ _mm_load_ps(&batch.viewZ[idx]) };
+
+				// Reflect(l, v) dotted with v
+				const __m128 scale{ _mm_mul_ps(_mm_set1_ps(2.f), Dot4(lx, ly, lz, vx, vy, vz)) };
+				const __m128 rx{ _mm_sub_ps(lx, _mm_mul_ps(vx, scale)) };
+				const __m128 ry{ _mm_sub_ps(ly, _mm_mul_ps(vy, scale)) };
+				const __m128 rz{ _mm_sub_ps(lz, _mm_mul_ps(vz, scale)) };
+				const __m128 cosA{ Dot4(rx, ry, rz, vx, vy, vz) };
+
+				if constexpr (integerExponent)
+				{
+					// same squaring as PowInteger, the exponent is the same for every lane
+					__m128 base{ cosA };
+					__m128 power{ _mm_set1_ps(1.f) };
+					for (unsigned int exponent{ static_cast<unsigned int>(exp) }; exponent > 0; exponent >>= 1u)
+					{
+						if (exponent & 1u) power = _mm_mul_ps(power, base);
+						base = _mm_mul_ps(base, base);
+					}
+
+					const __m128 result{ _mm_mul_ps(_mm_set1_ps(ks), power) };
+					_mm_store_ps(&specular[idx], _mm_andnot_ps(_mm_cmplt_ps(cosA, _mm_set1_ps(FLT_EPSILON)), result));
+				}
+				else
+				{
+					_mm_store_ps(&specular[idx], cosA);
+				}
+			}
+
+			// no vector powf, the lanes go through the scalar one
+			if constexpr (!integerExponent)
+			{
+				for (uint32_t lane{}; lane < batch.count; ++lane)
+				{
+					specular[lane] = specular[lane] < FLT_EPSILON ? 0.f : ks * powf(specular[lane], exp);
+				}
+			}
+
+			for (uint32_t lane{}; lane < batch.count; ++lane)
+			{
+				colors.Set(lane, diffuse + ColorRGB{ specular[lane] });
+			}
+#else
+			for (uint32_t lane{}; lane < batch.count; ++lane)
+			{
+				colors.Set(lane, diffuse + Phong<integerExponent>(ks, exp, batch.GetLight(lane), batch.GetView(lane), batch.GetNormal(lane)));
+			}
+#endif
+		}
+#pragma endregion
+
 	}
 }
\ No newline at end of file
@@ -0,0 +1,1002 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+
+#include "BVH.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint32_t maxLeafSize{ 8 };
+		constexpr float traversalCost{ 1.f };
+		constexpr float intersectionCost{ 1.f };
+		constexpr uint32_t builderVersion{ 2 };	// bump when the build algorithm changes (invalidates cached hierarchies)
+
+		constexpr uint32_t binnedBuildThreshold{ 1 << 16 };	// from this many primitives on the binned builder is used
+		constexpr uint32_t nrBins{ 32 };
+		constexpr uint32_t nrPrimitivesPerTask{ 1 << 14 };		// chunk size for the parallel passes over a node's primitives
+		constexpr uint32_t minParallelNodeSize{ 1 << 15 };		// smaller nodes are built as a subtree by one worker
+
+		constexpr uint32_t mortonBitsPerAxis{ 10 };				// 30 bit codes
+		constexpr uint32_t radixBits{ 8 };						// 4 passes cover the 30 bits
+		constexpr uint32_t linearLeafSize{ 4 };
+
+		struct BuildContext
+		{
+			const std::vector<AABB>& bounds;
+			std::vector<Vector3> centroids;
+			std::vector<float> rightAreas;
+			BVH& bvh;
+		};
+
+		void UpdateNodeBounds(BuildContext& context, const uint32_t nodeIdx, const uint32_t first, const uint32_t count)
+		{
+			AABB nodeBounds{};
+			for (uint32_t idx{ first }; idx < first + count; ++idx)
+			{
+				nodeBounds.Grow(context.bounds[context.bvh.primitiveIndices[idx]]);
+			}
+
+			BVHNode& node{ context.bvh.nodes[nodeIdx] };
+			node.minAABB = nodeBounds.minimum;
+			node.maxAABB = nodeBounds.maximum;
+		}
+
+		void SortByAxis(BuildContext& context, const uint32_t first, const uint32_t count, const int axis)
+		{
+			const auto begin{ context.bvh.primitiveIndices.begin() + first };
+			std::sort(begin, begin + count, [&](const uint32_t a, const uint32_t b)
+			{
+				const float centroidA{ context.centroids[a][axis] };
+				const float centroidB{ context.centroids[b][axis] };
+
+				// tie break on index so sorting the same range twice always gives the same order
+				return centroidA < centroidB || (centroidA == centroidB && a < b);
+			});
+		}
+
+		// Runs task(taskIdx) for every taskIdx in [0, nrTasks), on the pool when there is one
+		void RunTasks(ThreadPool* pThreadPool, const uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+		{
+			if (pThreadPool && nrTasks > 1)
+			{
+				pThreadPool->ParallelFor(nrTasks, task);
+				return;
+			}
+
+			for (uint32_t taskIdx{}; taskIdx < nrTasks; ++taskIdx)
+			{
+				task(taskIdx);
+			}
+		}
+
+		uint32_t GetNrOfTasks(const uint32_t count)
+		{
+			return (count + nrPrimitivesPerTask - 1) / nrPrimitivesPerTask;
+		}
+
+		std::vector<AABB> CalculateTriangleBounds(const std::vector<Vector3>& positions, const std::vector<int>& indices, ThreadPool* pThreadPool)
+		{
+			const size_t nrTrianglePoints{ 3 };
+			const uint32_t nrTriangles{ static_cast<uint32_t>(indices.size() / nrTrianglePoints) };
+
+			std::vector<AABB> triangleBounds(nrTriangles);
+			RunTasks(pThreadPool, GetNrOfTasks(nrTriangles), [&](uint32_t taskIdx)
+			{
+				const uint32_t first{ taskIdx * nrPrimitivesPerTask };
+				const uint32_t last{ std::min(first + nrPrimitivesPerTask, nrTriangles) };
+				for (uint32_t triangleIdx{ first }; triangleIdx < last; ++triangleIdx)
+				{
+					const size_t baseIdx{ triangleIdx * nrTrianglePoints };
+
+					AABB& bounds{ triangleBounds[triangleIdx] };
+					bounds.Grow(positions[indices[baseIdx]]);
+					bounds.Grow(positions[indices[baseIdx + 1]]);
+					bounds.Grow(positions[indices[baseIdx + 2]]);
+				}
+			});
+
+			return triangleBounds;
+		}
+
+		void Subdivide(BuildContext& context, const uint32_t nodeIdx, const uint32_t first, const uint32_t count, const uint32_t depth)
+		{
+			UpdateNodeBounds(context, nodeIdx, first, count);
+
+			const BVHNode& node{ context.bvh.nodes[nodeIdx] };
+			const float nodeArea{ AABB{ node.minAABB, node.maxAABB }.SurfaceArea() };
+			const float leafCost{ intersectionCost * count };
+
+			int bestAxis{ -1 };
+			uint32_t bestSplit{};
+			float bestCost{ FLT_MAX };
+
+			if (count > 1 && depth < BVH::maxDepth)
+			{
+				for (int axis{}; axis < 3; ++axis)
+				{
+					SortByAxis(context, first, count, axis);
+
+					// sweep from the right to store the area of every right partition
+					AABB rightBounds{};
+					for (uint32_t idx{ count - 1 }; idx > 0; --idx)
+					{
+						rightBounds.Grow(context.bounds[context.bvh.primitiveIndices[first + idx]]);
+						context.rightAreas[idx] = rightBounds.SurfaceArea();
+					}
+
+					// sweep from the left and evaluate every split position
+					AABB leftBounds{};
+					for (uint32_t idx{ 1 }; idx < count; ++idx)
+					{
+						leftBounds.Grow(context.bounds[context.bvh.primitiveIndices[first + idx - 1]]);
+
+						const float cost{ leftBounds.SurfaceArea() * idx + context.rightAreas[idx] * (count - idx) };
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = axis;
+							bestSplit = idx;
+						}
+					}
+				}
+
+				bestCost = traversalCost + intersectionCost * bestCost / nodeArea;
+			}
+
+			const bool splitIsWorthIt{ bestCost < leafCost || count > maxLeafSize };
+			if (bestAxis < 0 || !splitIsWorthIt)
+			{
+				BVHNode& leaf{ context.bvh.nodes[nodeIdx] };
+				leaf.leftFirst = first;
+				leaf.primitiveCount = count;
+				return;
+			}
+
+			if (bestAxis != 2) SortByAxis(context, first, count, bestAxis);
+
+			const uint32_t leftChildIdx{ static_cast<uint32_t>(context.bvh.nodes.size()) };
+			context.bvh.nodes.emplace_back();
+			context.bvh.nodes.emplace_back();
+
+			BVHNode& innerNode{ context.bvh.nodes[nodeIdx] };
+			innerNode.leftFirst = leftChildIdx;
+			innerNode.primitiveCount = 0;
+
+			Subdivide(context, leftChildIdx, first, bestSplit, depth + 1);
+			Subdivide(context, leftChildIdx + 1, first + bestSplit, count - bestSplit, depth + 1);
+		}
+
+		// ---- Binned SAH build ----
+		// Every node is split on one of nrBins equal slices of its centroid bounds, a split only moves primitives, it never sorts them
+		// Bin bounds are only grown (min/max), so the chosen splits don't depend on how the binning was divided over the workers
+
+		struct Bin
+		{
+			AABB bounds{};
+			AABB centroidBounds{};
+			uint32_t count{};
+
+			void Grow(const Bin& other)
+			{
+				bounds.Grow(other.bounds);
+				centroidBounds.Grow(other.centroidBounds);
+				count += other.count;
+			}
+		};
+
+		using Bins = std::array<std::array<Bin, nrBins>, 3>;
+
+		struct BinnedTask
+		{
+			uint32_t nodeIdx;
+			uint32_t first;
+			uint32_t count;
+			uint32_t depth;
+			AABB bounds;
+			AABB centroidBounds;
+		};
+
+		constexpr int halfSplitAxis{ 3 };
+
+		struct BinnedSplit
+		{
+			int axis{ -1 };			// -1: no split (leaf), halfSplitAxis: the range is cut in half as it is
+			uint32_t binIdx{};		// primitives in bins [0, binIdx) go left (half split: the number of primitives that go left)
+			float cost{ FLT_MAX };
+			Bin left{};
+			Bin right{};
+		};
+
+		struct BinnedContext
+		{
+			const std::vector<AABB>& bounds;
+			std::vector<Vector3> centroids;
+			std::vector<uint32_t> partitionBuffer;	// parallel partition scatters into this
+			BVH& bvh;
+		};
+
+		struct BinMapping
+		{
+			Vector3 minimum;
+			Vector3 scale;			// nrBins / extent, 0 for a flat axis
+		};
+
+		BinMapping GetBinMapping(const AABB& centroidBounds)
+		{
+			BinMapping mapping{ centroidBounds.minimum, {} };
+			const Vector3 extent{ centroidBounds.maximum - centroidBounds.minimum };
+			for (int axis{}; axis < 3; ++axis)
+			{
+				mapping.scale[axis] = extent[axis] > 0.f ? nrBins / extent[axis] : 0.f;
+			}
+			return mapping;
+		}
+
+		uint32_t GetBinIdx(const BinMapping& mapping, const Vector3& centroid, const int axis)
+		{
+			const float binPosition{ (centroid[axis] - mapping.minimum[axis]) * mapping.scale[axis] };
+			return std::min(nrBins - 1, static_cast<uint32_t>(std::max(binPosition, 0.f)));
+		}
+
+		void BinPrimitives(const BinnedContext& context, const BinMapping& mapping, const uint32_t first, const uint32_t last, Bins& bins)
+		{
+			for (uint32_t idx{ first }; idx < last; ++idx)
+			{
+				const uint32_t primitiveIdx{ context.bvh.primitiveIndices[idx] };
+				const AABB& primitiveBounds{ context.bounds[primitiveIdx] };
+				const Vector3& centroid{ context.centroids[primitiveIdx] };
+
+				for (int axis{}; axis < 3; ++axis)
+				{
+					Bin& bin{ bins[axis][GetBinIdx(mapping, centroid, axis)] };
+					bin.bounds.Grow(primitiveBounds);
+					bin.centroidBounds.Grow(centroid);
+					++bin.count;
+				}
+			}
+		}
+
+		BinnedSplit FindBestSplit(const Bins& bins, const BinMapping& mapping)
+		{
+			BinnedSplit bestSplit{};
+
+			for (int axis{}; axis < 3; ++axis)
+			{
+				if (mapping.scale[axis] == 0.f) continue;
+
+				// sweep from the right to store the area and size of every right partition
+				float rightAreas[nrBins]{};
+				uint32_t rightCounts[nrBins]{};
+				AABB rightBounds{};
+				uint32_t rightCount{};
+				float rightArea{};
+				for (uint32_t binIdx{ nrBins - 1 }; binIdx > 0; --binIdx)
+				{
+					// small nodes leave most bins empty, those don't change the partition
+					const Bin& bin{ bins[axis][binIdx] };
+					if (bin.count > 0)
+					{
+						rightBounds.Grow(bin.bounds);
+						rightCount += bin.count;
+						rightArea = rightBounds.SurfaceArea();
+					}
+					rightAreas[binIdx] = rightArea;
+					rightCounts[binIdx] = rightCount;
+				}
+
+				// sweep from the left and evaluate every split between two bins
+				AABB leftBounds{};
+				uint32_t leftCount{};
+				float leftArea{};
+				for (uint32_t binIdx{ 1 }; binIdx < nrBins; ++binIdx)
+				{
+					const Bin& bin{ bins[axis][binIdx - 1] };
+					if (bin.count > 0)
+					{
+						leftBounds.Grow(bin.bounds);
+						leftCount += bin.count;
+						leftArea = leftBounds.SurfaceArea();
+					}
+					if (leftCount == 0 || rightCounts[binIdx] == 0) continue;
+
+					const float cost{ leftArea * leftCount + rightAreas[binIdx] * rightCounts[binIdx] };
+					if (cost < bestSplit.cost)
+					{
+						bestSplit.axis = axis;
+						bestSplit.binIdx = binIdx;
+						bestSplit.cost = cost;
+					}
+				}
+			}
+
+			// the children's bounds come straight from the bins
+			if (bestSplit.axis >= 0)
+			{
+				for (uint32_t binIdx{}; binIdx < nrBins; ++binIdx)
+				{
+					if (bins[bestSplit.axis][binIdx].count == 0) continue;
+
+					Bin& side{ binIdx < bestSplit.binIdx ? bestSplit.left : bestSplit.right };
+					side.Grow(bins[bestSplit.axis][binIdx]);
+				}
+			}
+
+			return bestSplit;
+		}
+
+		bool GoesLeft(const BinnedContext& context, const BinMapping& mapping, const BinnedSplit& split, const uint32_t primitiveIdx)
+		{
+			return GetBinIdx(mapping, context.centroids[primitiveIdx], split.axis) < split.binIdx;
+		}
+
+		Bin CalculateBin(const BinnedContext& context, const uint32_t first, const uint32_t last)
+		{
+			Bin bin{};
+			for (uint32_t idx{ first }; idx < last; ++idx)
+			{
+				const uint32_t primitiveIdx{ context.bvh.primitiveIndices[idx] };
+				bin.bounds.Grow(context.bounds[primitiveIdx]);
+				bin.centroidBounds.Grow(context.centroids[primitiveIdx]);
+				++bin.count;
+			}
+			return bin;
+		}
+
+		// Decides between a leaf and a split, the split is only returned when it is worth it (or forced by the leaf size)
+		// No usable split (all centroids in one bin) but too many primitives for a leaf: the range is cut in half as it is
+		BinnedSplit ChooseSplit(const BinnedTask& task, const Bins& bins, const BinMapping& mapping)
+		{
+			BinnedSplit split{ FindBestSplit(bins, mapping) };
+			if (split.axis >= 0) split.cost = traversalCost + intersectionCost * split.cost / task.bounds.SurfaceArea();
+
+			const float leafCost{ intersectionCost * task.count };
+			if (split.axis >= 0 && (split.cost < leafCost || task.count > maxLeafSize)) return split;
+			if (task.count <= maxLeafSize) return {};
+
+			BinnedSplit halfSplit{};
+			halfSplit.axis = halfSplitAxis;
+			halfSplit.binIdx = task.count / 2;
+			return halfSplit;
+		}
+
+		void MakeLeaf(std::vector<BVHNode>& nodes, const BinnedTask& task)
+		{
+			BVHNode& leaf{ nodes[task.nodeIdx] };
+			leaf.minAABB = task.bounds.minimum;
+			leaf.maxAABB = task.bounds.maximum;
+			leaf.leftFirst = task.first;
+			leaf.primitiveCount = task.count;
+		}
+
+		// Turns the node of the task into an inner node with two new children and returns their tasks
+		void MakeInnerNode(const BinnedContext& context, std::vector<BVHNode>& nodes, const BinnedTask& task, const BinnedSplit& split,
+			const uint32_t nrLeft, BinnedTask& leftTask, BinnedTask& rightTask)
+		{
+			const uint32_t leftChildIdx{ static_cast<uint32_t>(nodes.size()) };
+			nodes.emplace_back();
+			nodes.emplace_back();
+
+			BVHNode& innerNode{ nodes[task.nodeIdx] };
+			innerNode.minAABB = task.bounds.minimum;
+			innerNode.maxAABB = task.bounds.maximum;
+			innerNode.leftFirst = leftChildIdx;
+			innerNode.primitiveCount = 0;
+
+			const uint32_t middle{ task.first + nrLeft };
+			const uint32_t last{ task.first + task.count };
+
+			// the half split has no bins, its children are measured
+			const Bin left{ split.axis != halfSplitAxis ? split.left : CalculateBin(context, task.first, middle) };
+			const Bin right{ split.axis != halfSplitAxis ? split.right : CalculateBin(context, middle, last) };
+
+			leftTask = BinnedTask{ leftChildIdx, task.first, nrLeft, task.depth + 1, left.bounds, left.centroidBounds };
+			rightTask = BinnedTask{ leftChildIdx + 1, middle, task.count - nrLeft, task.depth + 1, right.bounds, right.centroidBounds };
+		}
+
+		// Whole subtree on the calling thread, into nodes (a worker's own array when building in parallel)
+		void BuildBinnedSubtree(const BinnedContext& context, std::vector<BVHNode>& nodes, const BinnedTask& rootTask)
+		{
+			std::vector<BinnedTask> taskStack{ rootTask };
+			Bins bins{};
+
+			while (!taskStack.empty())
+			{
+				const BinnedTask task{ taskStack.back() };
+				taskStack.pop_back();
+
+				if (task.count <= 1 || task.depth >= BVH::maxDepth)
+				{
+					MakeLeaf(nodes, task);
+					continue;
+				}
+
+				const BinMapping mapping{ GetBinMapping(task.centroidBounds) };
+				bins = Bins{};
+				BinPrimitives(context, mapping, task.first, task.first + task.count, bins);
+
+				const BinnedSplit split{ ChooseSplit(task, bins, mapping) };
+				if (split.axis < 0)
+				{
+					MakeLeaf(nodes, task);
+					continue;
+				}
+
+				uint32_t nrLeft{ split.binIdx };
+				if (split.axis != halfSplitAxis)
+				{
+					// stable, so the result is the same as the parallel partition
+					const auto begin{ context.bvh.primitiveIndices.begin() + task.first };
+					const auto middle{ std::stable_partition(begin, begin + task.count, [&](const uint32_t primitiveIdx)
+					{
+						return GoesLeft(context, mapping, split, primitiveIdx);
+					}) };
+					nrLeft = static_cast<uint32_t>(middle - begin);
+				}
+
+				BinnedTask leftTask{};
+				BinnedTask rightTask{};
+				MakeInnerNode(context, nodes, task, split, nrLeft, leftTask, rightTask);
+
+				taskStack.emplace_back(rightTask);
+				taskStack.emplace_back(leftTask);
+			}
+		}
+
+		// Same split as BuildBinnedSubtree, but the binning and the partition of the node are spread over the pool
+		BinnedSplit SplitInParallel(BinnedContext& context, ThreadPool* pThreadPool, const BinnedTask& task, uint32_t& nrLeft)
+		{
+			const BinMapping mapping{ GetBinMapping(task.centroidBounds) };
+			const uint32_t nrTasks{ GetNrOfTasks(task.count) };
+			const uint32_t last{ task.first + task.count };
+
+			std::vector<Bins> taskBins(nrTasks);
+			RunTasks(pThreadPool, nrTasks, [&](uint32_t taskIdx)
+			{
+				const uint32_t first{ task.first + taskIdx * nrPrimitivesPerTask };
+				BinPrimitives(context, mapping, first, std::min(first + nrPrimitivesPerTask, last), taskBins[taskIdx]);
+			});
+
+			Bins bins{};
+			for (const Bins& chunkBins : taskBins)
+			{
+				for (int axis{}; axis < 3; ++axis)
+				{
+					for (uint32_t binIdx{}; binIdx < nrBins; ++binIdx)
+					{
+						bins[axis][binIdx].Grow(chunkBins[axis][binIdx]);
+					}
+				}
+			}
+
+			const BinnedSplit split{ task.depth < BVH::maxDepth ? ChooseSplit(task, bins, mapping) : BinnedSplit{} };
+			nrLeft = split.binIdx;
+			if (split.axis < 0 || split.axis == halfSplitAxis) return split;
+
+			// stable parallel partition: count per chunk, then every chunk scatters to its own spot in the buffer
+			std::vector<uint32_t> nrLeftPerTask(nrTasks);
+			RunTasks(pThreadPool, nrTasks, [&](uint32_t taskIdx)
+			{
+				const uint32_t first{ task.first + taskIdx * nrPrimitivesPerTask };
+				const uint32_t chunkLast{ std::min(first + nrPrimitivesPerTask, last) };
+				for (uint32_t idx{ first }; idx < chunkLast; ++idx)
+				{
+					nrLeftPerTask[taskIdx] += GoesLeft(context, mapping, split, context.bvh.primitiveIndices[idx]);
+				}
+			});
+
+			std::vector<uint32_t> leftOffsets(nrTasks);
+			nrLeft = 0;
+			for (uint32_t taskIdx{}; taskIdx < nrTasks; ++taskIdx)
+			{
+				leftOffsets[taskIdx] = nrLeft;
+				nrLeft += nrLeftPerTask[taskIdx];
+			}
+
+			RunTasks(pThreadPool, nrTasks, [&](uint32_t taskIdx)
+			{
+				const uint32_t first{ task.first + taskIdx * nrPrimitivesPerTask };
+				const uint32_t chunkLast{ std::min(first + nrPrimitivesPerTask, last) };
+
+				uint32_t leftIdx{ leftOffsets[taskIdx] };
+				uint32_t rightIdx{ nrLeft + (first - task.first) - leftOffsets[taskIdx] };
+				for (uint32_t idx{ first }; idx < chunkLast; ++idx)
+				{
+					const uint32_t primitiveIdx{ context.bvh.primitiveIndices[idx] };
+					if (GoesLeft(context, mapping, split, primitiveIdx)) context.partitionBuffer[leftIdx++] = primitiveIdx;
+					else context.partitionBuffer[rightIdx++] = primitiveIdx;
+				}
+			});
+
+			std::copy(context.partitionBuffer.begin(), context.partitionBuffer.begin() + task.count, context.bvh.primitiveIndices.begin() + task.first);
+			return split;
+		}
+
+		void BuildBinned(BinnedContext& context, ThreadPool* pThreadPool)
+		{
+			const uint32_t nrPrimitives{ static_cast<uint32_t>(context.bounds.size()) };
+			const uint32_t nrTasks{ GetNrOfTasks(nrPrimitives) };
+
+			// root bounds, merged in chunk order
+			std::vector<Bin> taskBins(nrTasks);
+			RunTasks(pThreadPool, nrTasks, [&](uint32_t taskIdx)
+			{
+				const uint32_t first{ taskIdx * nrPrimitivesPerTask };
+				taskBins[taskIdx] = CalculateBin(context, first, std::min(first + nrPrimitivesPerTask, nrPrimitives));
+			});
+
+			Bin root{};
+			for (const Bin& bin : taskBins)
+			{
+				root.Grow(bin);
+			}
+
+			std::vector<BVHNode>& nodes{ context.bvh.nodes };
+			nodes.emplace_back();
+
+			// top of the tree: big nodes are split one by one, each split in parallel
+			std::vector<BinnedTask> openTasks{ BinnedTask{ 0, 0, nrPrimitives, 0, root.bounds, root.centroidBounds } };
+			std::vector<BinnedTask> subtreeTasks{};
+			for (size_t taskIdx{}; taskIdx < openTasks.size(); ++taskIdx)
+			{
+				const BinnedTask task{ openTasks[taskIdx] };
+				if (task.count < minParallelNodeSize)
+				{
+					subtreeTasks.emplace_back(task);
+					continue;
+				}
+
+				uint32_t nrLeft{};
+				const BinnedSplit split{ SplitInParallel(context, pThreadPool, task, nrLeft) };
+				if (split.axis < 0)
+				{
+					MakeLeaf(nodes, task);
+					continue;
+				}
+
+				BinnedTask leftTask{};
+				BinnedTask rightTask{};
+				MakeInnerNode(context, nodes, task, split, nrLeft, leftTask, rightTask);
+				openTasks.emplace_back(leftTask);
+				openTasks.emplace_back(rightTask);
+			}
+
+			// the subtrees: one per worker at a time, each into its own node array (its root in slot 0)
+			const uint32_t nrSubtrees{ static_cast<uint32_t>(subtreeTasks.size()) };
+			std::vector<std::vector<BVHNode>> subtreeNodes(nrSubtrees);
+			RunTasks(pThreadPool, nrSubtrees, [&](uint32_t subtreeIdx)
+			{
+				BinnedTask task{ subtreeTasks[subtreeIdx] };
+				task.nodeIdx = 0;
+
+				std::vector<BVHNode>& localNodes{ subtreeNodes[subtreeIdx] };
+				localNodes.reserve(size_t{ task.count } * 2 - 1);
+				localNodes.emplace_back();
+				BuildBinnedSubtree(context, localNodes, task);
+			});
+
+			// stitch: the root goes in the slot its parent made for it, the rest is appended (children stay after their parent)
+			for (uint32_t subtreeIdx{}; subtreeIdx < nrSubtrees; ++subtreeIdx)
+			{
+				const std::vector<BVHNode>& localNodes{ subtreeNodes[subtreeIdx] };
+				const uint32_t offset{ static_cast<uint32_t>(nodes.size()) - 1 };
+
+				const auto relocate = [offset](BVHNode node)
+				{
+					if (!node.IsLeaf()) node.leftFirst += offset;
+					return node;
+				};
+
+				nodes[subtreeTasks[subtreeIdx].nodeIdx] = relocate(localNodes[0]);
+				for (size_t localIdx{ 1 }; localIdx < localNodes.size(); ++localIdx)
+				{
+					nodes.emplace_back(relocate(localNodes[localIdx]));
+				}
+			}
+		}
+
+		// ---- Linear build ----
+
+		// Spreads the lower 10 bits so there are two zero bits between every bit (room to interleave the other axes)
+		uint32_t ExpandBits(uint32_t value)
+		{
+			value = (value * 0x00010001u) & 0xFF0000FFu;
+			value = (value * 0x00000101u) & 0x0F00F00Fu;
+			value = (value * 0x00000011u) & 0xC30C30C3u;
+			value = (value * 0x00000005u) & 0x49249249u;
+			return value;
+		}
+
+		// point relative to the centroid bounds, [0, 1] on every axis
+		uint32_t CalculateMortonCode(const Vector3& relativePoint)
+		{
+			constexpr float gridSize{ 1 << mortonBitsPerAxis };
+			const auto quantize = [gridSize](const float value)
+			{
+				return static_cast<uint32_t>(std::clamp(value * gridSize, 0.f, gridSize - 1.f));
+			};
+
+			return (ExpandBits(quantize(relativePoint.x)) << 2) | (ExpandBits(quantize(relativePoint.y)) << 1) | ExpandBits(quantize(relativePoint.z));
+		}
+
+		// LSD radix sort of the primitive indices on their code, stable so equal codes keep their primitive order
+		void SortByMortonCode(std::vector<uint32_t>& codes, std::vector<uint32_t>& primitiveIndices)
+		{
+			constexpr uint32_t nrBuckets{ 1 << radixBits };
+			const size_t nrPrimitives{ codes.size() };
+
+			std::vector<uint32_t> sortedCodes(nrPrimitives);
+			std::vector<uint32_t> sortedIndices(nrPrimitives);
+
+			for (uint32_t shift{}; shift < 3 * mortonBitsPerAxis; shift += radixBits)
+			{
+				uint32_t bucketOffsets[nrBuckets]{};
+				for (const uint32_t code : codes)
+				{
+					++bucketOffsets[(code >> shift) & (nrBuckets - 1)];
+				}
+
+				uint32_t offset{};
+				for (uint32_t& bucketOffset : bucketOffsets)
+				{
+					const uint32_t bucketSize{ bucketOffset };
+					bucketOffset = offset;
+					offset += bucketSize;
+				}
+
+				for (size_t idx{}; idx < nrPrimitives; ++idx)
+				{
+					const uint32_t destination{ bucketOffsets[(codes[idx] >> shift) & (nrBuckets - 1)]++ };
+					sortedCodes[destination] = codes[idx];
+					sortedIndices[destination] = primitiveIndices[idx];
+				}
+
+				codes.swap(sortedCodes);
+				primitiveIndices.swap(sortedIndices);
+			}
+		}
+
+		// Top down over the sorted codes, only the topology: the bounds are filled in by a refit afterwards
+		void EmitLinearNodes(const std::vector<uint32_t>& codes, std::vector<BVHNode>& nodes)
+		{
+			struct LinearTask
+			{
+				uint32_t nodeIdx;
+				uint32_t first;
+				uint32_t count;
+				uint32_t depth;
+			};
+
+			nodes.emplace_back();
+			std::vector<LinearTask> taskStack{ LinearTask{ 0, 0, static_cast<uint32_t>(codes.size()), 0 } };
+
+			while (!taskStack.empty())
+			{
+				const LinearTask task{ taskStack.back() };
+				taskStack.pop_back();
+
+				if (task.count <= linearLeafSize || task.depth >= BVH::maxDepth)
+				{
+					nodes[task.nodeIdx].leftFirst = task.first;
+					nodes[task.nodeIdx].primitiveCount = task.count;
+					continue;
+				}
+
+				const auto begin{ codes.begin() + task.first };
+				const auto end{ begin + task.count };
+				const uint32_t firstCode{ *begin };
+				const uint32_t lastCode{ *(end - 1) };
+
+				// all codes share the bits above the highest one where the first and last differ, split where that bit flips
+				// (left: code ^ firstCode stays below that bit, right: it doesn't), equal codes are cut in half
+				uint32_t nrLeft{ task.count / 2 };
+				if (firstCode != lastCode)
+				{
+					const auto split{ std::partition_point(begin, end, [firstCode, lastCode](const uint32_t code)
+					{
+						return (code ^ firstCode) < (code ^ lastCode);
+					}) };
+					nrLeft = static_cast<uint32_t>(split - begin);
+				}
+
+				const uint32_t leftChildIdx{ static_cast<uint32_t>(nodes.size()) };
+				nodes.emplace_back();
+				nodes.emplace_back();
+
+				nodes[task.nodeIdx].leftFirst = leftChildIdx;
+				nodes[task.nodeIdx].primitiveCount = 0;
+
+				taskStack.emplace_back(LinearTask{ leftChildIdx + 1, task.first + nrLeft, task.count - nrLeft, task.depth + 1 });
+				taskStack.emplace_back(LinearTask{ leftChildIdx, task.first, nrLeft, task.depth + 1 });
+			}
+		}
+	}
+
+	void BVH::Build(const std::vector<AABB>& primitiveBounds, ThreadPool* pThreadPool)
+	{
+		const auto startTime{ std::chrono::steady_clock::now() };
+		Clear();
+
+		const uint32_t nrPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+		if (nrPrimitives == 0) return;
+
+		primitiveIndices.resize(nrPrimitives);
+		for (uint32_t primitiveIdx{}; primitiveIdx < nrPrimitives; ++primitiveIdx)
+		{
+			primitiveIndices[primitiveIdx] = primitiveIdx;
+		}
+
+		std::vector<Vector3> centroids(nrPrimitives);
+		RunTasks(nrPrimitives >= binnedBuildThreshold ? pThreadPool : nullptr, GetNrOfTasks(nrPrimitives), [&](uint32_t taskIdx)
+		{
+			const uint32_t first{ taskIdx * nrPrimitivesPerTask };
+			const uint32_t last{ std::min(first + nrPrimitivesPerTask, nrPrimitives) };
+			for (uint32_t primitiveIdx{ first }; primitiveIdx < last; ++primitiveIdx)
+			{
+				centroids[primitiveIdx] = primitiveBounds[primitiveIdx].Centroid();
+			}
+		});
+
+		nodes.reserve(size_t{ nrPrimitives } * 2 - 1);
+
+		if (nrPrimitives >= binnedBuildThreshold)
+		{
+			BinnedContext context{ primitiveBounds, std::move(centroids), {}, *this };
+			context.partitionBuffer.resize(nrPrimitives);
+
+			BuildBinned(context, pThreadPool);
+		}
+		else
+		{
+			BuildContext context{ primitiveBounds, std::move(centroids), {}, *this };
+			context.rightAreas.resize(nrPrimitives);
+
+			nodes.emplace_back();
+			Subdivide(context, 0, 0, nrPrimitives, 0);
+		}
+
+		nodes.shrink_to_fit();
+		UpdateWideNodes();
+
+		buildTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	void BVH::BuildTriangles(const std::vector<Vector3>& positions, const std::vector<int>& indices, ThreadPool* pThreadPool)
+	{
+		const auto startTime{ std::chrono::steady_clock::now() };
+
+		const bool isBig{ indices.size() / 3 >= binnedBuildThreshold };
+		Build(CalculateTriangleBounds(positions, indices, isBig ? pThreadPool : nullptr), pThreadPool);
+
+		buildTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	void BVH::BuildLinear(const std::vector<AABB>& primitiveBounds, ThreadPool* pThreadPool)
+	{
+		const auto startTime{ std::chrono::steady_clock::now() };
+		Clear();
+
+		const uint32_t nrPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+		if (nrPrimitives == 0) return;
+
+		// centroid bounds, merged in chunk order
+		const uint32_t nrTasks{ GetNrOfTasks(nrPrimitives) };
+		std::vector<AABB> taskCentroidBounds(nrTasks);
+		RunTasks(pThreadPool, nrTasks, [&](uint32_t taskIdx)
+		{
+			const uint32_t first{ taskIdx * nrPrimitivesPerTask };
+			const uint32_t last{ std::min(first + nrPrimitivesPerTask, nrPrimitives) };
+			for (uint32_t primitiveIdx{ first }; primitiveIdx < last; ++primitiveIdx)
+			{
+				taskCentroidBounds[taskIdx].Grow(primitiveBounds[primitiveIdx].Centroid());
+			}
+		});
+
+		AABB centroidBounds{};
+		for (const AABB& bounds : taskCentroidBounds)
+		{
+			centroidBounds.Grow(bounds);
+		}
+
+		const Vector3 extent{ centroidBounds.maximum - centroidBounds.minimum };
+		const Vector3 inverseExtent{
+			extent.x > 0.f ? 1.f / extent.x : 0.f,
+			extent.y > 0.f ? 1.f / extent.y : 0.f,
+			extent.z > 0.f ? 1.f / extent.z : 0.f };
+
+		std::vector<uint32_t> codes(nrPrimitives);
+		primitiveIndices.resize(nrPrimitives);
+		RunTasks(pThreadPool, nrTasks, [&](uint32_t taskIdx)
+		{
+			const uint32_t first{ taskIdx * nrPrimitivesPerTask };
+			const uint32_t last{ std::min(first + nrPrimitivesPerTask, nrPrimitives) };
+			for (uint32_t primitiveIdx{ first }; primitiveIdx < last; ++primitiveIdx)
+			{
+				const Vector3 relativeCentroid{ primitiveBounds[primitiveIdx].Centroid() - centroidBounds.minimum };
+				codes[primitiveIdx] = CalculateMortonCode({
+					relativeCentroid.x * inverseExtent.x,
+					relativeCentroid.y * inverseExtent.y,
+					relativeCentroid.z * inverseExtent.z });
+				primitiveIndices[primitiveIdx] = primitiveIdx;
+			}
+		});
+
+		SortByMortonCode(codes, primitiveIndices);
+
+		nodes.reserve(size_t{ nrPrimitives } * 2 - 1);
+		EmitLinearNodes(codes, nodes);
+		Refit(primitiveBounds);		// also collapses
+
+		buildTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	void BVH::BuildTrianglesLinear(const std::vector<Vector3>& positions, const std::vector<int>& indices, ThreadPool* pThreadPool)
+	{
+		const auto startTime{ std::chrono::steady_clock::now() };
+
+		BuildLinear(CalculateTriangleBounds(positions, indices, pThreadPool), pThreadPool);
+
+		buildTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	void BVH::Refit(const std::vector<AABB>& primitiveBounds)
+	{
+		// children are always stored after their parent, so walking backwards visits them first
+		for (size_t nodeIdx{ nodes.size() }; nodeIdx-- > 0;)
+		{
+			BVHNode& node{ nodes[nodeIdx] };
+
+			AABB nodeBounds{};
+			if (node.IsLeaf())
+			{
+				for (uint32_t idx{ node.leftFirst }; idx < node.leftFirst + node.primitiveCount; ++idx)
+				{
+					nodeBounds.Grow(primitiveBounds[primitiveIndices[idx]]);
+				}
+			}
+			else
+			{
+				const BVHNode& leftChild{ nodes[node.leftFirst] };
+				const BVHNode& rightChild{ nodes[node.leftFirst + 1] };
+				nodeBounds.Grow(AABB{ leftChild.minAABB, leftChild.maxAABB });
+				nodeBounds.Grow(AABB{ rightChild.minAABB, rightChild.maxAABB });
+			}
+
+			node.minAABB = nodeBounds.minimum;
+			node.maxAABB = nodeBounds.maximum;
+		}
+
+		UpdateWideNodes();
+	}
+
+	void BVH::RefitTriangles(const std::vector<Vector3>& positions, const std::vector<int>& indices)
+	{
+		Refit(CalculateTriangleBounds(positions, indices, nullptr));
+	}
+
+	uint64_t BVH::GetBuildSettingsHash()
+	{
+		const auto combine = [](uint64_t hash, const uint64_t value)
+		{
+			return (hash ^ value) * 0x100000001b3ull;
+		};
+
+		uint64_t hash{ 0xcbf29ce484222325ull };
+		hash = combine(hash, builderVersion);
+		hash = combine(hash, maxLeafSize);
+		hash = combine(hash, BVH::maxDepth);
+		hash = combine(hash, binnedBuildThreshold);
+		hash = combine(hash, nrBins);
+		hash = combine(hash, static_cast<uint64_t>(traversalCost * 1000.f));
+		hash = combine(hash, static_cast<uint64_t>(intersectionCost * 1000.f));
+		hash = combine(hash, sizeof(BVHNode));
+		return hash;
+	}
+
+	void BVH::UpdateWideNodes()
+	{
+		wideNodes.clear();
+		if (nodes.empty()) return;
+
+		// a wide node takes the two children of its binary node, then keeps opening the biggest inner child until it has 4 children
+		// (skips the levels in between, the leaves stay the same)
+		struct CollapseTask
+		{
+			uint32_t wideNodeIdx;
+			uint32_t binaryNodeIdx;
+		};
+
+		wideNodes.reserve(nodes.size() / 3 + 1);
+		wideNodes.emplace_back();
+		std::vector<CollapseTask> taskStack{ CollapseTask{ 0, 0 } };
+
+		while (!taskStack.empty())
+		{
+			const CollapseTask task{ taskStack.back() };
+			taskStack.pop_back();
+
+			uint32_t slots[wideBVHWidth]{};
+			uint32_t nrSlots{};
+
+			const BVHNode& binaryNode{ nodes[task.binaryNodeIdx] };
+			if (binaryNode.IsLeaf())
+			{
+				// only for a root that is a leaf
+				slots[nrSlots++] = task.binaryNodeIdx;
+			}
+			else
+			{
+				slots[nrSlots++] = binaryNode.leftFirst;
+				slots[nrSlots++] = binaryNode.leftFirst + 1;
+			}
+
+			while (nrSlots < wideBVHWidth)
+			{
+				int biggestSlot{ -1 };
+				float biggestArea{ -1.f };
+				for (uint32_t slot{}; slot < nrSlots; ++slot)
+				{
+					const BVHNode& child{ nodes[slots[slot]] };
+					if (child.IsLeaf()) continue;
+
+					const float area{ AABB{ child.minAABB, child.maxAABB }.SurfaceArea() };
+					if (area > biggestArea)
+					{
+						biggestArea = area;
+						biggestSlot = static_cast<int>(slot);
+					}
+				}
+				if (biggestSlot < 0) break;
+
+				const uint32_t openedNodeIdx{ slots[biggestSlot] };
+				slots[biggestSlot] = nodes[openedNodeIdx].leftFirst;
+				slots[nrSlots++] = nodes[openedNodeIdx].leftFirst + 1;
+			}
+
+			WideBVHNode wideNode{};
+			for (uint32_t slot{}; slot < wideBVHWidth; ++slot)
+			{
+				if (slot >= nrSlots)
+				{
+					wideNode.primitiveCounts[slot] = WideBVHNode::emptyChild;
+					continue;
+				}
+
+				const BVHNode& child{ nodes[slots[slot]] };
+				wideNode.minX[slot] = child.minAABB.x;
+				wideNode.minY[slot] = child.minAABB.y;
+				wideNode.minZ[slot] = child.minAABB.z;
+				wideNode.maxX[slot] = child.maxAABB.x;
+				wideNode.maxY[slot] = child.maxAABB.y;
+				wideNode.maxZ[slot] = child.maxAABB.z;
+
+				if (child.IsLeaf())
+				{
+					wideNode.children[slot] = child.leftFirst;
+					wideNode.primitiveCounts[slot] = child.primitiveCount;
+				}
+				else
+				{
+					const uint32_t childIdx{ static_cast<uint32_t>(wideNodes.size()) };
+					wideNodes.emplace_back();
+					taskStack.emplace_back(CollapseTask{ childIdx, slots[slot] });
+
+					wideNode.children[slot] = childIdx;
+					wideNode.primitiveCounts[slot] = 0;
+				}
+			}
+			wideNodes[task.wideNodeIdx] = wideNode;
+		}
+	}
+
+	void BVH::Clear()
+	{
+		nodes.clear();
+		primitiveIndices.clear();
+		wideNodes.clear();
+		buildTimeMs = 0.f;
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct AABB
+	{
+		Vector3 minimum{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maximum{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const Vector3& point)
+		{
+			minimum = Vector3::Min(minimum, point);
+			maximum = Vector3::Max(maximum, point);
+		}
+
+		void Grow(const AABB& other)
+		{
+			minimum = Vector3::Min(minimum, other.minimum);
+			maximum = Vector3::Max(maximum, other.maximum);
+		}
+
+		const Vector3 Centroid() const
+		{
+			return (minimum + maximum) * 0.5f;
+		}
+
+		const float SurfaceArea() const
+		{
+			const Vector3 extent{ maximum - minimum };
+			return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+	};
+
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		uint32_t leftFirst{};		// inner node: index of left child (right = left + 1) | leaf: first index in primitiveIndices
+		Vector3 maxAABB{};
+		uint32_t primitiveCount{};	// 0 for inner nodes
+
+		bool IsLeaf() const { return primitiveCount > 0; }
+	};
+	// the SSE slab test loads minAABB/maxAABB as 4 floats (the 4th lane is leftFirst/primitiveCount and ignored)
+	static_assert(sizeof(BVHNode) == 32, "BVHNode is expected to be two 16 byte rows");
+
+	constexpr uint32_t wideBVHWidth{ 4 };
+
+	// Node of the collapsed (4-wide) hierarchy: the bounds of all children side by side (SoA), so one SIMD slab test covers them
+	struct alignas(64) WideBVHNode
+	{
+		static constexpr uint32_t emptyChild{ UINT32_MAX };
+
+		float minX[wideBVHWidth];
+		float minY[wideBVHWidth];
+		float minZ[wideBVHWidth];
+		float maxX[wideBVHWidth];
+		float maxY[wideBVHWidth];
+		float maxZ[wideBVHWidth];
+		uint32_t children[wideBVHWidth];			// inner child: index in wideNodes | leaf child: first index in primitiveIndices
+		uint32_t primitiveCounts[wideBVHWidth];		// 0 for inner children, emptyChild for the unused slots (always the last ones)
+	};
+	static_assert(sizeof(WideBVHNode) == 128, "WideBVHNode is expected to fill two cache lines");
+
+	class ThreadPool;
+
+	// SAH: the best trees, for static meshes (these are also the ones that get cached)
+	// Fast: linear BVH, a fraction of the build time for somewhat slower tracing, for meshes that are rebuilt every frame
+	enum class BVHBuildMode
+	{
+		SAH,
+		Fast
+	};
+
+	// Bounding volume hierarchy built with the surface area heuristic
+	// Small sets get a full sweep over the sorted centroids, big ones (meshes) a binned SAH build: the top splits are binned
+	// and partitioned in parallel, the subtrees below are then built by one worker each (pThreadPool = nullptr: all on the calling thread)
+	// Nodes are stored with the two children of an inner node next to each other and always after their parent, node 0 is the root
+	struct BVH
+	{
+		std::vector<BVHNode> nodes{};
+		std::vector<uint32_t> primitiveIndices{};
+
+		// The same hierarchy collapsed to up to 4 children per node (same leaves), this is what mesh rays traverse
+		// Every build and refit updates it, anything else that fills nodes (cache) calls UpdateWideNodes itself
+		std::vector<WideBVHNode> wideNodes{};
+		float buildTimeMs{};		// time the last Build took (0 for a hierarchy that came from a cache), for the stats output
+
+		// Deepest level a leaf can sit at (root = 0), traversal uses fixed size stacks so the tree has to stay this shallow
+		static constexpr uint32_t maxDepth{ 60 };
+
+		// pThreadPool is not used for small sets, and can't be a pool that is busy (ParallelFor doesn't nest)
+		void Build(const std::vector<AABB>& primitiveBounds, ThreadPool* pThreadPool = nullptr);
+		void BuildTriangles(const std::vector<Vector3>& positions, const std::vector<int>& indices, ThreadPool* pThreadPool = nullptr);
+
+		// Linear BVH: primitives radix sorted along a Morton curve over their centroids, every node splits on the highest differing code bit
+		void BuildLinear(const std::vector<AABB>& primitiveBounds, ThreadPool* pThreadPool = nullptr);
+		void BuildTrianglesLinear(const std::vector<Vector3>& positions, const std::vector<int>& indices, ThreadPool* pThreadPool = nullptr);
+
+		// Bottom up update of the node bounds, keeps the topology (only for primitives that moved, not for added/removed ones)
+		void Refit(const std::vector<AABB>& primitiveBounds);
+		void RefitTriangles(const std::vector<Vector3>& positions, const std::vector<int>& indices);
+
+		void UpdateWideNodes();
+
+		void Clear();
+
+		bool IsEmpty() const { return nodes.empty(); }
+
+		// Changes whenever the builder or its parameters change, cached hierarchies built with other settings are stale
+		static uint64_t GetBuildSettingsHash();
+	};
+}
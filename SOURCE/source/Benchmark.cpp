@@ -0,0 +1,167 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+#include "RenderStats.h"
+
+// The revision the build was made from: the pre-build step in RayTracer.props writes GitRevision.h to the intermediate directory,
+// other builds can pass it themselves (e.g. -DDAE_GIT_REVISION="\"$(git rev-parse --short HEAD)\"")
+#if !defined(DAE_GIT_REVISION) && __has_include("GitRevision.h")
+#include "GitRevision.h"
+#endif
+#ifndef DAE_GIT_REVISION
+#define DAE_GIT_REVISION "unknown"
+#endif
+
+namespace dae
+{
+	namespace
+	{
+		// linear interpolation between the closest ranks, sortedValues may not be empty
+		double GetPercentile(const std::vector<double>& sortedValues, const double percentile)
+		{
+			const double rank{ percentile / 100.0 * (sortedValues.size() - 1) };
+			const size_t lowerIdx{ static_cast<size_t>(rank) };
+			const size_t upperIdx{ std::min(lowerIdx + 1, sortedValues.size() - 1) };
+			const double fraction{ rank - lowerIdx };
+
+			return sortedValues[lowerIdx] + (sortedValues[upperIdx] - sortedValues[lowerIdx]) * fraction;
+		}
+	}
+
+	Benchmark::Benchmark(const BenchmarkSettings& settings)
+		: m_Settings{ settings }
+	{
+		m_FrameTimes.reserve(m_Settings.nrOfFrames);
+	}
+
+	bool Benchmark::AddFrame(const FrameStats& frameStats)
+	{
+		if (IsFinished()) return true;
+
+		if (m_NrOfSkippedFrames < m_Settings.nrOfWarmUpFrames)
+		{
+			++m_NrOfSkippedFrames;
+			return false;
+		}
+
+		m_FrameTimes.emplace_back(frameStats.frameTime * 1000.0);
+		m_NrOfRays += frameStats.counters.GetNrOfRays();
+		m_TotalTime += frameStats.frameTime;
+
+		return IsFinished();
+	}
+
+	BenchmarkResults Benchmark::CalculateResults() const
+	{
+		BenchmarkResults results{};
+		results.nrOfFrames = static_cast<uint32_t>(m_FrameTimes.size());
+		if (m_FrameTimes.empty()) return results;
+
+		std::vector<double> sortedTimes{ m_FrameTimes };
+		std::sort(sortedTimes.begin(), sortedTimes.end());
+
+		results.min = sortedTimes.front();
+		results.max = sortedTimes.back();
+		results.mean = std::accumulate(sortedTimes.begin(), sortedTimes.end(), 0.0) / sortedTimes.size();
+
+		// sample standard deviation
+		if (sortedTimes.size() > 1)
+		{
+			double squaredDeviations{};
+			for (const double time : sortedTimes)
+			{
+				squaredDeviations += (time - results.mean) * (time - results.mean);
+			}
+			results.standardDeviation = std::sqrt(squaredDeviations / (sortedTimes.size() - 1));
+		}
+
+		results.p50 = GetPercentile(sortedTimes, 50.0);
+		results.p95 = GetPercentile(sortedTimes, 95.0);
+		results.p99 = GetPercentile(sortedTimes, 99.0);
+
+		if (m_TotalTime > 0.0) results.mRaysPerSecond = m_NrOfRays / m_TotalTime / 1'000'000.0;
+
+		return results;
+	}
+
+	void Benchmark::PrintResults() const
+	{
+		const BenchmarkResults results{ CalculateResults() };
+
+		std::cout << "**BENCHMARK** " << m_Settings.sceneName << " " << m_Settings.width << "x" << m_Settings.height
+			<< ", " << m_Settings.nrOfThreads << " thread(s), revision " << DAE_GIT_REVISION
+			<< ", " << results.nrOfFrames << " frames (+" << m_NrOfSkippedFrames << " warm-up)\n";
+		std::cout << ">> ms/frame: p50 = " << results.p50 << ", p95 = " << results.p95 << ", p99 = " << results.p99
+			<< ", min = " << results.min << ", max = " << results.max
+			<< ", mean = " << results.mean << ", stddev = " << results.standardDeviation << "\n";
+		std::cout << ">> " << results.mRaysPerSecond << " Mrays/s\n";
+	}
+
+	bool Benchmark::SaveResults(const std::string& filePath) const
+	{
+		const BenchmarkResults results{ CalculateResults() };
+
+		const bool isCSV{ filePath.size() >= 4 && filePath.compare(filePath.size() - 4, 4, ".csv") == 0 };
+		return isCSV ? SaveCSV(filePath, results) : SaveJSON(filePath, results);
+	}
+
+	bool Benchmark::SaveJSON(const std::string& filePath, const BenchmarkResults& results) const
+	{
+		std::ofstream fileStream{ filePath };
+		if (!fileStream) return true;
+
+		fileStream << "{\n"
+			<< "\t\"scene\": \"" << m_Settings.sceneName << "\",\n"
+			<< "\t\"width\": " << m_Settings.width << ",\n"
+			<< "\t\"height\": " << m_Settings.height << ",\n"
+			<< "\t\"threads\": " << m_Settings.nrOfThreads << ",\n"
+			<< "\t\"revision\": \"" << DAE_GIT_REVISION << "\",\n"
+			<< "\t\"warmUpFrames\": " << m_NrOfSkippedFrames << ",\n"
+			<< "\t\"frames\": " << results.nrOfFrames << ",\n"
+			<< "\t\"frameTimeMs\": {\n"
+			<< "\t\t\"p50\": " << results.p50 << ",\n"
+			<< "\t\t\"p95\": " << results.p95 << ",\n"
+			<< "\t\t\"p99\": " << results.p99 << ",\n"
+			<< "\t\t\"min\": " << results.min << ",\n"
+			<< "\t\t\"max\": " << results.max << ",\n"
+			<< "\t\t\"mean\": " << results.mean << ",\n"
+			<< "\t\t\"stddev\": " << results.standardDeviation << "\n"
+			<< "\t},\n"
+			<< "\t\"mraysPerSecond\": " << results.mRaysPerSecond << ",\n"
+			<< "\t\"frameTimesMs\": [";
+
+		for (size_t frameIdx{}; frameIdx < m_FrameTimes.size(); ++frameIdx)
+		{
+			fileStream << (frameIdx == 0 ? "" : ", ") << m_FrameTimes[frameIdx];
+		}
+		fileStream << "]\n}\n";
+
+		return !fileStream;
+	}
+
+	bool Benchmark::SaveCSV(const std::string& filePath, const BenchmarkResults& results) const
+	{
+		const bool isNewFile{ !std::ifstream{ filePath } };
+
+		std::ofstream fileStream{ filePath, std::ios::app };
+		if (!fileStream) return true;
+
+		if (isNewFile)
+		{
+			fileStream << "scene,width,height,threads,revision,warmup_frames,frames,p50_ms,p95_ms,p99_ms,min_ms,max_ms,mean_ms,stddev_ms,mrays_per_s\n";
+		}
+
+		fileStream << m_Settings.sceneName << ',' << m_Settings.width << ',' << m_Settings.height << ',' << m_Settings.nrOfThreads << ','
+			<< DAE_GIT_REVISION << ',' << m_NrOfSkippedFrames << ',' << results.nrOfFrames << ','
+			<< results.p50 << ',' << results.p95 << ',' << results.p99 << ','
+			<< results.min << ',' << results.max << ',' << results.mean << ',' << results.standardDeviation << ','
+			<< results.mRaysPerSecond << '\n';
+
+		return !fileStream;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	struct FrameStats;
+
+	// What is being measured, written along with the results so runs of different builds can be compared
+	struct BenchmarkSettings
+	{
+		std::string sceneName{};
+		uint32_t width{};
+		uint32_t height{};
+		uint32_t nrOfThreads{};
+		uint32_t nrOfWarmUpFrames{ 10 };	// not recorded: caches, accumulation buffer, branch predictors...
+		uint32_t nrOfFrames{ 100 };			// recorded after the warm-up
+	};
+
+	struct BenchmarkResults
+	{
+		uint32_t nrOfFrames{};
+
+		// milliseconds per frame
+		double min{};
+		double max{};
+		double mean{};
+		double standardDeviation{};
+		double p50{};
+		double p95{};
+		double p99{};
+
+		double mRaysPerSecond{};
+	};
+
+	// Records the render time of every frame (Renderer::GetFrameStats) once the warm-up frames are done
+	class Benchmark final
+	{
+	public:
+		explicit Benchmark(const BenchmarkSettings& settings);
+		~Benchmark() = default;
+
+		Benchmark(const Benchmark&) = delete;
+		Benchmark(Benchmark&&) noexcept = delete;
+		Benchmark& operator=(const Benchmark&) = delete;
+		Benchmark& operator=(Benchmark&&) noexcept = delete;
+
+		// returns true once every frame is recorded, later frames are ignored
+		bool AddFrame(const FrameStats& frameStats);
+		bool IsFinished() const { return m_FrameTimes.size() >= m_Settings.nrOfFrames; }
+
+		BenchmarkResults CalculateResults() const;
+
+		void PrintResults() const;
+
+		// .csv appends one row (header when the file is new) so a file can collect runs over time, anything else is written as .json
+		// returns true on failure (SDL_SaveBMP convention, see Renderer::SaveBufferToImage)
+		bool SaveResults(const std::string& filePath) const;
+
+	private:
+		const BenchmarkSettings m_Settings;
+
+		uint32_t m_NrOfSkippedFrames{};
+		std::vector<double> m_FrameTimes{};	// milliseconds
+		uint64_t m_NrOfRays{};
+		double m_TotalTime{};				// seconds, recorded frames only
+
+		bool SaveJSON(const std::string& filePath, const BenchmarkResults& results) const;
+		bool SaveCSV(const std::string& filePath, const BenchmarkResults& results) const;
+	};
+}
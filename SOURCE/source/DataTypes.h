@@ -1,9 +1,31 @@
 #pragma once
 #include "Math.h"
+#include "BVH.h"
 #include "vector"
+#include <chrono>
+#include <future>
+#include <memory>
 
 namespace dae
 {
+#pragma region RAY
+	struct Ray
+	{
+		Vector3 origin{};
+		Vector3 direction{};
+
+		float min{ 0.0001f };
+		float max{ FLT_MAX };
+	};
+
+	// Coherent rays (2x2 pixel quad) traced together, see Scene::GetClosestHits
+	constexpr uint32_t rayPacketSize{ 4 };
+	struct RayPacket
+	{
+		Ray rays[rayPacketSize]{};
+	};
+
+#pragma endregion
 #pragma region GEOMETRY
 	struct Sphere
 	{
@@ -39,6 +61,87 @@ namespace dae
 		unsigned char materialIndex;
 	};
 
+	// Spheres/planes are also kept as structure of arrays (one array per component) for the batched hit tests,
+	// padded to a multiple of primitiveGroupSize so the SSE kernels always load whole groups
+	constexpr uint32_t primitiveGroupSize{ 4 };
+
+	inline size_t GetPaddedGroupSize(const size_t nrPrimitives)
+	{
+		return (nrPrimitives + primitiveGroupSize - 1) / primitiveGroupSize * primitiveGroupSize;
+	}
+
+	// Padding spheres have radiusSquared -FLT_MAX, no ray can hit them
+	struct SphereSoA
+	{
+		std::vector<float> originX{};
+		std::vector<float> originY{};
+		std::vector<float> originZ{};
+		std::vector<float> radiusSquared{};
+
+		void Set(const std::vector<Sphere>& spheres)
+		{
+			const size_t paddedSize{ GetPaddedGroupSize(spheres.size()) };
+
+			originX.assign(paddedSize, 0.f);
+			originY.assign(paddedSize, 0.f);
+			originZ.assign(paddedSize, 0.f);
+			radiusSquared.assign(paddedSize, -FLT_MAX);
+
+			for (size_t idx{}; idx < spheres.size(); ++idx)
+			{
+				originX[idx] = spheres[idx].origin.x;
+				originY[idx] = spheres[idx].origin.y;
+				originZ[idx] = spheres[idx].origin.z;
+				radiusSquared[idx] = spheres[idx].radius * spheres[idx].radius;
+			}
+		}
+
+		void Clear()
+		{
+			originX.clear();
+			originY.clear();
+			originZ.clear();
+			radiusSquared.clear();
+		}
+
+		size_t GetPaddedSize() const { return radiusSquared.size(); }
+	};
+
+	// Padding planes have a zero normal, every ray counts as parallel to them
+	struct PlaneSoA
+	{
+		std::vector<float> originX{};
+		std::vector<float> originY{};
+		std::vector<float> originZ{};
+		std::vector<float> normalX{};
+		std::vector<float> normalY{};
+		std::vector<float> normalZ{};
+
+		void Set(const std::vector<Plane>& planes)
+		{
+			const size_t paddedSize{ GetPaddedGroupSize(planes.size()) };
+
+			originX.assign(paddedSize, 0.f);
+			originY.assign(paddedSize, 0.f);
+			originZ.assign(paddedSize, 0.f);
+			normalX.assign(paddedSize, 0.f);
+			normalY.assign(paddedSize, 0.f);
+			normalZ.assign(paddedSize, 0.f);
+
+			for (size_t idx{}; idx < planes.size(); ++idx)
+			{
+				originX[idx] = planes[idx].origin.x;
+				originY[idx] = planes[idx].origin.y;
+				originZ[idx] = planes[idx].origin.z;
+				normalX[idx] = planes[idx].normal.x;
+				normalY[idx] = planes[idx].normal.y;
+				normalZ[idx] = planes[idx].normal.z;
+			}
+		}
+
+		size_t GetPaddedSize() const { return normalX.size(); }
+	};
+
 	enum class TriangleCullMode
 	{
 		FrontFaceCulling,
@@ -71,73 +174,61 @@ namespace dae
 		unsigned char materialIndex{};
 	};
 
-	struct TriangleMesh
+	// Everything the intersection test needs of one triangle in one place (Möller–Trumbore: v0 + the two edges from it)
+	struct TriangleRecord
 	{
-		TriangleMesh()
-		{
-			positions.reserve(30);
-			normals.reserve(10);
-			indices.reserve(30);
-		}
+		Vector3 v0{};
+		Vector3 edge1{};	// v1 - v0
+		Vector3 edge2{};	// v2 - v0
+		Vector3 normal{};	// face normal, for culling and shading
+	};
 
-		TriangleMesh(TriangleCullMode _cullMode, const unsigned char _matIdx)
-			: cullMode{ _cullMode }, materialIndex{ _matIdx }
+	// Shared vertex/index data + hierarchy in object space, referenced by every TriangleMesh (instance) that uses it
+	struct TriangleMeshGeometry
+	{
+		TriangleMeshGeometry()
 		{
 			positions.reserve(30);
 			normals.reserve(10);
 			indices.reserve(30);
 		}
 
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode = TriangleCullMode::NoCulling):
-		positions(_positions), indices(_indices), cullMode(_cullMode)
+		TriangleMeshGeometry(const std::vector<Vector3>& _positions, const std::vector<int>& _indices) :
+			positions(_positions), indices(_indices)
 		{
 			CalculateNormals();
-
-			UpdateTransforms();
+			UpdateAABB();
 		}
 
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode = TriangleCullMode::NoCulling) :
-			positions(_positions), indices(_indices), normals(_normals), cullMode(_cullMode)
+		TriangleMeshGeometry(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals) :
+			positions(_positions), normals(_normals), indices(_indices)
 		{
-			UpdateTransforms();
+			UpdateAABB();
 		}
 
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
-		unsigned char materialIndex{};
-
-		TriangleCullMode cullMode{};
-
-		Matrix rotationTransform{};
-		Matrix translationTransform{};
-		Matrix scaleTransform{};
 
 		Vector3 minAABB{};
 		Vector3 maxAABB{};
 
-		Vector3 transformedMinAABB{};
-		Vector3 transformedMaxAABB{};
+		BVH bvh{};
 
-		std::vector<Vector3> transformedPositions{};
-		std::vector<Vector3> transformedNormals{};
+		// One record per triangle in hierarchy leaf order (triangleRecords[i] is triangle bvh.primitiveIndices[i]),
+		// so a leaf's triangles are read contiguously without going through indices, see UpdateTriangleRecords
+		std::vector<TriangleRecord> triangleRecords{};
 
-		void Translate(const Vector3& translation)
-		{
-			translationTransform = Matrix::CreateTranslation(translation);
-		}
+		BVHBuildMode bvhBuildMode{ BVHBuildMode::SAH };	// Fast for geometry that deforms every frame (see MarkDeformed)
 
-		void RotateY(const float yaw)
-		{
-			rotationTransform = Matrix::CreateRotationY(yaw);
-		}
+		// Bumped whenever the positions (and so the bounds and hierarchy) changed, instances compare it with the version they last saw
+		uint32_t version{};
+		bool isDeformed{ false };
 
-		void Scale(const Vector3& scale)
-		{
-			scaleTransform = Matrix::CreateScale(scale);
-		}
+		// Hierarchy being rebuilt on a worker thread (stale cache, see Utils::LoadMesh), meanwhile bvh is a refitted older one
+		std::future<BVH> pendingBVH{};
 
-		void AppendTriangle(const Triangle& triangle, const bool ignoreTransformUpdate = false)
+		void AppendTriangle(const Triangle& triangle)
 		{
 			int startIndex = static_cast<int>(positions.size());
 
@@ -151,8 +242,10 @@ namespace dae
 
 			normals.emplace_back(triangle.normal);
 
-			//Not ideal, but making sure all vertices are updated
-			if(!ignoreTransformUpdate) UpdateTransforms();
+			// topology changed, hierarchy gets rebuilt by the next UpdateTransforms of an instance
+			bvh.Clear();
+			triangleRecords.clear();
+			if (pendingBVH.valid()) pendingBVH.get();	// was built for the old triangles, wait for it and drop it
 		}
 
 		void CalculateNormals()
@@ -174,48 +267,210 @@ namespace dae
 			}
 		}
 
-		void UpdateTransforms()
+		void UpdateAABB()
 		{
-			const Matrix finalTransform{ scaleTransform * rotationTransform * translationTransform };
+			if (positions.empty())
+			{
+				return;
+			}
 
-			//Transform Positions (positions > transformedPositions)
-			transformedPositions.resize(positions.size());
-			for (size_t idx{}; idx < positions.size(); ++idx)
+			minAABB = positions[0];
+			maxAABB = positions[0];
+
+			for (const auto& p : positions)
 			{
-				transformedPositions[idx] = finalTransform.TransformPoint(positions[idx]);
+				minAABB = Vector3::Min(p, minAABB);
+				maxAABB = Vector3::Max(p, maxAABB);
 			}
+		}
 
-			//Transform Normals (normals > transformedNormals)
-			transformedNormals.resize(normals.size());
-			for (size_t idx{}; idx < normals.size(); ++idx)
+		// Full rebuild of the hierarchy (SAH or linear, see bvhBuildMode), needed after adding/removing triangles
+		// big meshes build on pThreadPool when given
+		void BuildBVH(ThreadPool* pThreadPool = nullptr)
+		{
+			if (bvhBuildMode == BVHBuildMode::Fast) bvh.BuildTrianglesLinear(positions, indices, pThreadPool);
+			else bvh.BuildTriangles(positions, indices, pThreadPool);
+
+			UpdateTriangleRecords();
+		}
+
+		// Cheap bottom up update of the hierarchy after moving vertices of the object space positions (deforming mesh)
+		void RefitBVH()
+		{
+			bvh.RefitTriangles(positions, indices);
+			UpdateTriangleRecords();
+		}
+
+		// Gathers the triangles in the hierarchy's leaf order, call whenever bvh or the positions/normals changed
+		// (BuildBVH, RefitBVH and InstallPendingBVH do)
+		void UpdateTriangleRecords()
+		{
+			const size_t nrTrianglePoints{ 3 };
+
+			triangleRecords.resize(bvh.primitiveIndices.size());
+
+			for (size_t recordIdx{}; recordIdx < triangleRecords.size(); ++recordIdx)
 			{
-				transformedNormals[idx] = finalTransform.TransformVector(normals[idx]);
+				const size_t triangleIdx{ bvh.primitiveIndices[recordIdx] };
+				const size_t baseIdx{ triangleIdx * nrTrianglePoints };
+
+				const Vector3& P0 = positions[indices[baseIdx]];
+				const Vector3& P1 = positions[indices[baseIdx + 1]];
+				const Vector3& P2 = positions[indices[baseIdx + 2]];
+
+				triangleRecords[recordIdx] = { P0, P1 - P0, P2 - P0, normals[triangleIdx] };
 			}
+		}
 
-			// Update AABB
-			UpdateTransformedAABB(finalTransform);
+		// Call after moving vertices (deforming mesh), normals, bounds and hierarchy get updated at the start of the next frame
+		void MarkDeformed()
+		{
+			isDeformed = true;
+		}
+
+		// Applies a MarkDeformed, only call when no rays are being traced (Scene::UpdateTopLevelBVH does)
+		bool UpdateDeformation(ThreadPool* pThreadPool)
+		{
+			if (!isDeformed) return false;
+			isDeformed = false;
+
+			if (pendingBVH.valid()) pendingBVH.get();	// was built for the old positions, wait for it and drop it
+
+			CalculateNormals();
+			UpdateAABB();
+			BuildBVH(pThreadPool);
+			++version;
+			return true;
+		}
+
+		// Swaps in the background built hierarchy once it is done, only call when no rays are being traced (start of a frame)
+		bool InstallPendingBVH()
+		{
+			if (!pendingBVH.valid() || pendingBVH.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready) return false;
+
+			bvh = pendingBVH.get();
+			UpdateTriangleRecords();
+			return true;
+		}
+	};
+
+	// Instance of a TriangleMeshGeometry: own transform, material and cull mode, geometry can be shared between many meshes
+	struct TriangleMesh
+	{
+		TriangleMesh() :
+			geometry{ std::make_shared<TriangleMeshGeometry>() }
+		{
+		}
+
+		TriangleMesh(TriangleCullMode _cullMode, const unsigned char _matIdx)
+			: geometry{ std::make_shared<TriangleMeshGeometry>() }, materialIndex{ _matIdx }, cullMode{ _cullMode }
+		{
+		}
+
+		TriangleMesh(const std::shared_ptr<TriangleMeshGeometry>& _geometry, TriangleCullMode _cullMode, const unsigned char _matIdx)
+			: geometry{ _geometry }, materialIndex{ _matIdx }, cullMode{ _cullMode }
+		{
+		}
+
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode = TriangleCullMode::NoCulling):
+			geometry{ std::make_shared<TriangleMeshGeometry>(_positions, _indices) }, cullMode(_cullMode)
+		{
+			UpdateTransforms();
+		}
+
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode = TriangleCullMode::NoCulling) :
+			geometry{ std::make_shared<TriangleMeshGeometry>(_positions, _indices, _normals) }, cullMode(_cullMode)
+		{
+			UpdateTransforms();
+		}
+
+		std::shared_ptr<TriangleMeshGeometry> geometry{};
+		unsigned char materialIndex{};
+
+		TriangleCullMode cullMode{};
+
+		Matrix rotationTransform{};
+		Matrix translationTransform{};
+		Matrix scaleTransform{};
+
+		Vector3 transformedMinAABB{};
+		Vector3 transformedMaxAABB{};
+
+		// Rays get transformed into object space (inverseTransform) for intersection,
+		// so moving the mesh never touches the vertices or the BVH (built over the object space positions)
+		Matrix worldTransform{};
+		Matrix inverseTransform{};
+
+		// set when the transform or the geometry bounds changed, cleared by the scene once it has seen it
+		bool hasMoved{ true };
+		uint32_t geometryVersion{};		// geometry->version the transformed bounds were calculated for
+
+		void Translate(const Vector3& translation)
+		{
+			translationTransform = Matrix::CreateTranslation(translation);
+		}
+
+		void RotateY(const float yaw)
+		{
+			rotationTransform = Matrix::CreateRotationY(yaw);
+		}
+
+		void Scale(const Vector3& scale)
+		{
+			scaleTransform = Matrix::CreateScale(scale);
 		}
 
+		// Appends to the shared geometry, so every instance of it gets the triangle
+		void AppendTriangle(const Triangle& triangle, const bool ignoreTransformUpdate = false)
+		{
+			geometry->AppendTriangle(triangle);
+
+			//Not ideal, but making sure all vertices are updated
+			if(!ignoreTransformUpdate) UpdateTransforms();
+		}
+
+		void CalculateNormals()
+		{
+			geometry->CalculateNormals();
+		}
 
 		void UpdateAABB()
 		{
-			if (positions.empty())
+			geometry->UpdateAABB();
+			hasMoved = true;
+		}
+
+		void UpdateTransforms()
+		{
+			const Matrix newWorldTransform{ scaleTransform * rotationTransform * translationTransform };
+			if (newWorldTransform != worldTransform)
 			{
-				return;
+				worldTransform = newWorldTransform;
+				inverseTransform = Matrix::Inverse(worldTransform);
+				hasMoved = true;
 			}
 
-			minAABB = positions[0];
-			maxAABB = positions[0];
-
-			for (const auto& p : positions)
+			if (geometry->bvh.IsEmpty())
 			{
-				minAABB = Vector3::Min(p, minAABB);
-				maxAABB = Vector3::Max(p, maxAABB);
+				geometry->BuildBVH();
+				hasMoved = true;
 			}
+
+			// Update AABB
+			UpdateTransformedAABB(worldTransform);
+		}
+
+		const Ray TransformRayToObject(const Ray& ray) const
+		{
+			// direction is not normalized again so t stays the same in both spaces
+			return { inverseTransform.TransformPoint(ray.origin), inverseTransform.TransformVector(ray.direction), ray.min, ray.max };
 		}
 
 		void UpdateTransformedAABB(const Matrix& finalTransform)
 		{
+			const Vector3& minAABB{ geometry->minAABB };
+			const Vector3& maxAABB{ geometry->maxAABB };
+
 			// AABB update: be careful -> transform the 8 vertices of the aabb
 			// and calculate new min and max.
 			Vector3 tMinAABB = finalTransform.TransformPoint(minAABB);
@@ -289,21 +544,30 @@ namespace dae
 
 #pragma endregion
 #pragma region MISC
-	struct Ray
+	enum class HitObjectType : unsigned char
 	{
-		Vector3 origin{};
-		Vector3 direction{};
-
-		float min{ 0.0001f };
-		float max{ FLT_MAX };
+		Sphere,
+		Plane,
+		TriangleMesh
 	};
 
 	struct HitRecord
 	{
+		// surface data, only built for the final closest hit (see Scene::GetClosestHit)
 		Vector3 origin{};
 		Vector3 normal{};
 		float t{ FLT_MAX };
 
+		// barycentric weights of v1 and v2 of the hit triangle (v0 gets 1 - u - v), only set for triangle meshes
+		float u{};
+		float v{};
+
+		// what the traversal keeps of the closest hit so far: the scene's sphere/plane/mesh index,
+		// for meshes also the triangle (index into the geometry's triangleRecords)
+		uint32_t objectIdx{};
+		uint32_t triangleIdx{};
+		HitObjectType objectType{};
+
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
 	};
@@ -2,11 +2,12 @@
 #include "GameScenes.h"
 
 #include "Utils.h"
+#include "MeshCache.h"
 #include "Material.h"
 
 namespace dae
 {
-	void Scene_W1::Initialize()
+	void Scene_W1::Initialize(ThreadPool*)
 	{
 		sceneName = "scene week 1";
 		m_Camera.origin = { 0.f, 0.f, 0.f };
@@ -47,7 +48,7 @@ namespace dae
 		std::cout << "\n";
 	}
 
-	void Scene_W2::Initialize()
+	void Scene_W2::Initialize(ThreadPool*)
 	{
 		sceneName = "scene week 2";
 		m_Camera.origin = { 0.f, 3.f, -9.f };
@@ -79,7 +80,7 @@ namespace dae
 		AddPointLight(Vector3{ 0.f, 5.f, -5.f }, 70.f, colors::White); //Backlight
 	}
 
-	void Scene_W3_TestScene::Initialize()
+	void Scene_W3_TestScene::Initialize(ThreadPool*)
 	{
 		sceneName = "test scene week 3";
 		m_Camera.origin = { 0.f, 1.f, -5.f };
@@ -105,7 +106,7 @@ namespace dae
 		AddPointLight({ 0.f, 2.5f, -5.f }, 25.f, colors::White);
 	}
 
-	void Scene_W3::Initialize()
+	void Scene_W3::Initialize(ThreadPool*)
 	{
 		sceneName = "Scene Week 3";
 		m_Camera.origin = { 0.f, 3.f, -9.f };
@@ -153,7 +154,7 @@ namespace dae
 		AddPointLight(Vector3{ 2.5f, 2.5f, -5.f }, 50.f, ColorRGB{ .34f, .47f, .68f });
 	}
 
-	void Scene_W4_TestScene::Initialize()
+	void Scene_W4_TestScene::Initialize(ThreadPool* pThreadPool)
 	{
 		sceneName = "test scene week 4";
 		m_Camera.origin = { 0.f,1.f, -5.f };
@@ -183,13 +184,13 @@ namespace dae
 		//Triangle Mesh
 		//=============
 		//m_pMesh = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		//m_pMesh->positions = {
+		//m_pMesh->geometry->positions = {
 		//	{-.75f,-1.f,.0f},  //V0
 		//	{-.75f,1.f, .0f},  //V2
 		//	{.75f,1.f,1.f},    //V3
 		//	{.75f,-1.f,0.f} }; //V4
 
-		//m_pMesh->indices = {
+		//m_pMesh->geometry->indices = {
 		//	0,1,2, //Triangle 1
 		//	0,2,3  //Triangle 2
 		//};
@@ -205,19 +206,17 @@ namespace dae
 		////OBJ
 		////===
 		m_pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ(
+		Utils::LoadMesh(
 			//"Resources/simple_quad.obj",
 			//"Resources/simple_cube.obj",
 			"Resources/simple_object.obj",
 			//"Resources/lowpoly_bunny.obj",
-			m_pMesh->positions,
-			m_pMesh->normals,
-			m_pMesh->indices);
+			*m_pMesh->geometry, pThreadPool);
 
 		m_pMesh->Scale({ .7f,.7f,.7f });
 		m_pMesh->Translate({ .0f,1.f,0.f });
 
-		//No need to Calculate the normals, these are calculated inside the ParseOBJ function
+		//No need to Calculate the normals, these come with LoadMesh (parsed or from the cache)
 		m_pMesh->UpdateAABB();
 		m_pMesh->UpdateTransforms();
 
@@ -239,7 +238,7 @@ namespace dae
 		}
 	}
 
-	void Scene_W4_ReferenceScene::Initialize()
+	void Scene_W4_ReferenceScene::Initialize(ThreadPool*)
 	{
 		sceneName = "reference scene week 4";
 		m_Camera.origin = { 0.f, 3.f, -9.f };
@@ -280,16 +279,13 @@ namespace dae
 		m_Meshes[0]->UpdateAABB();
 		m_Meshes[0]->UpdateTransforms();
 
-		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_Meshes[1]->AppendTriangle(baseTriangle, true);
+		// same triangle, only the cull mode and transform differ
+		m_Meshes[1] = AddTriangleMeshInstance(*m_Meshes[0], TriangleCullMode::FrontFaceCulling, matLambert_White);
 		m_Meshes[1]->Translate({ 0.f,4.5f,0.f });
-		m_Meshes[1]->UpdateAABB();
 		m_Meshes[1]->UpdateTransforms();
 
-		m_Meshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_Meshes[2]->AppendTriangle(baseTriangle, true);
+		m_Meshes[2] = AddTriangleMeshInstance(*m_Meshes[0], TriangleCullMode::NoCulling, matLambert_White);
 		m_Meshes[2]->Translate({ 1.75f,4.5f,0.f });
-		m_Meshes[2]->UpdateAABB();
 		m_Meshes[2]->UpdateTransforms();
 
 		AddPointLight(Vector3{ 0.f, 5.f, 5.f }, 50.f, ColorRGB{ 1.f, .61f, .45f }); //Backlight
@@ -309,7 +305,7 @@ namespace dae
 		}
 	}
 
-	void Scene_W4_BunnyScene::Initialize()
+	void Scene_W4_BunnyScene::Initialize(ThreadPool* pThreadPool)
 	{
 		sceneName = "Bunny Scene W4";
 		m_Camera.origin = { 0.f, 3.f, -10.f };
@@ -330,17 +326,13 @@ namespace dae
 		////BUNNY OBJ
 		////===
 		m_pBunnyMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ(
-			"Resources/lowpoly_bunny.obj",
-			m_pBunnyMesh->positions,
-			m_pBunnyMesh->normals,
-			m_pBunnyMesh->indices);
+		Utils::LoadMesh("Resources/lowpoly_bunny.obj", *m_pBunnyMesh->geometry, pThreadPool);
 
 		m_pBunnyMesh->Scale({ 2.f, 2.f, 2.f });
 		m_pBunnyMesh->Translate({ 0.f, 0.f, 0.f });
 		m_pBunnyMesh->RotateY(PI);
 
-		//No need to Calculate the normals, these are calculated inside the ParseOBJ function
+		//No need to Calculate the normals, these come with LoadMesh (parsed or from the cache)
 		m_pBunnyMesh->UpdateAABB();
 		m_pBunnyMesh->UpdateTransforms();
 
@@ -362,7 +354,7 @@ namespace dae
 		}
 	}
 
-	void Scene_W4_Extra::Initialize()
+	void Scene_W4_Extra::Initialize(ThreadPool* pThreadPool)
 	{
 		sceneName = "Bunny Scene W4";
 		m_Camera.origin = { 0.f, 3.f, -10.f };
@@ -379,11 +371,7 @@ namespace dae
 		m_Meshes.resize(2);
 
 		m_Meshes[0] = AddTriangleMesh(TriangleCullMode::NoCulling, matCT_GreenMediumMetal);
-		Utils::ParseOBJ(
-			"Resources/truck.obj",
-			m_Meshes[0]->positions,
-			m_Meshes[0]->normals,
-			m_Meshes[0]->indices);
+		Utils::LoadMesh("Resources/truck.obj", *m_Meshes[0]->geometry, pThreadPool);
 
 		m_Meshes[0]->Scale({ 0.15f, 0.15f, 0.15f });
 		m_Meshes[0]->RotateY((PI_DIV_2 * 0.5f) * 3.f + PI);
@@ -395,13 +383,9 @@ namespace dae
 		//////===
 
 		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matCT_GrayMediumMetal);
-		Utils::ParseOBJ(
-			"Resources/lowpoly_bunny.obj",
-			m_Meshes[1]->positions,
-			m_Meshes[1]->normals,
-			m_Meshes[1]->indices);
+		Utils::LoadMesh("Resources/lowpoly_bunny.obj", *m_Meshes[1]->geometry, pThreadPool);
 
-		//No need to Calculate the normals, these are calculated inside the ParseOBJ function
+		//No need to Calculate the normals, these come with LoadMesh (parsed or from the cache)
 		m_Meshes[1]->Scale({ 2.f, 2.f, 2.f });
 		m_Meshes[1]->Translate({ 0.f, 0.f, 0.f });
 		m_Meshes[1]->UpdateAABB();
@@ -5,6 +5,7 @@ namespace dae
 {
 	//Forward Declarations
 	class Timer;
+	class ThreadPool;
 	class Material;
 	struct Plane;
 	struct Sphere;
@@ -27,7 +28,7 @@ namespace dae
 		Scene_W1& operator=(const Scene_W1&) = delete;
 		Scene_W1& operator=(Scene_W1&&) noexcept = delete;
 
-		void Initialize() override;
+		void Initialize(ThreadPool* pThreadPool) override;
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -43,7 +44,7 @@ namespace dae
 		Scene_W2& operator=(const Scene_W2&) = delete;
 		Scene_W2& operator=(Scene_W2&&) noexcept = delete;
 
-		void Initialize() override;
+		void Initialize(ThreadPool* pThreadPool) override;
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -59,7 +60,7 @@ namespace dae
 		Scene_W3_TestScene& operator=(const Scene_W3_TestScene&) = delete;
 		Scene_W3_TestScene& operator=(Scene_W3_TestScene&&) noexcept = delete;
 
-		void Initialize() override;
+		void Initialize(ThreadPool* pThreadPool) override;
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -75,7 +76,7 @@ namespace dae
 		Scene_W3& operator=(const Scene_W3&) = delete;
 		Scene_W3& operator=(Scene_W3&&) noexcept = delete;
 
-		void Initialize() override;
+		void Initialize(ThreadPool* pThreadPool) override;
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -91,7 +92,7 @@ namespace dae
 		Scene_W4_TestScene& operator=(const Scene_W4_TestScene&) = delete;
 		Scene_W4_TestScene& operator=(Scene_W4_TestScene&&) noexcept = delete;
 
-		void Initialize() override;
+		void Initialize(ThreadPool* pThreadPool) override;
 		void Update(Timer* pTimer) override;
 
 	private:
@@ -111,7 +112,7 @@ namespace dae
 		Scene_W4_ReferenceScene& operator=(const Scene_W4_ReferenceScene&) = delete;
 		Scene_W4_ReferenceScene& operator=(Scene_W4_ReferenceScene&&) noexcept = delete;
 
-		void Initialize() override;
+		void Initialize(ThreadPool* pThreadPool) override;
 		void Update(Timer* pTimer) override;
 
 	private:
@@ -131,7 +132,7 @@ namespace dae
 		Scene_W4_BunnyScene& operator=(const Scene_W4_BunnyScene&) = delete;
 		Scene_W4_BunnyScene& operator=(Scene_W4_BunnyScene&&) noexcept = delete;
 
-		void Initialize() override;
+		void Initialize(ThreadPool* pThreadPool) override;
 		void Update(Timer* pTimer) override;
 	private:
 		TriangleMesh* m_pBunnyMesh{ nullptr };
@@ -150,7 +151,7 @@ namespace dae
 		Scene_W4_Extra& operator=(const Scene_W4_Extra&) = delete;
 		Scene_W4_Extra& operator=(Scene_W4_Extra&&) noexcept = delete;
 
-		void Initialize() override;
+		void Initialize(ThreadPool* pThreadPool) override;
 		void Update(Timer* pTimer) override;
 	private:
 		std::vector<TriangleMesh*> m_Meshes{};
@@ -0,0 +1,82 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& filePath)
+	{
+		HANDLE fileHandle{ CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (fileHandle == INVALID_HANDLE_VALUE) return;
+		m_FileHandle = fileHandle;
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(fileHandle, &fileSize)) return;
+
+		m_Size = static_cast<size_t>(fileSize.QuadPart);
+		if (m_Size == 0)
+		{
+			// can't map an empty file, but it is a valid (empty) file
+			m_IsOpen = true;
+			return;
+		}
+
+		m_MappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_MappingHandle) return;
+
+		m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+		m_IsOpen = m_pData != nullptr;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_pData) UnmapViewOfFile(m_pData);
+		if (m_MappingHandle) CloseHandle(m_MappingHandle);
+		if (m_FileHandle) CloseHandle(m_FileHandle);
+	}
+#else
+	MappedFile::MappedFile(const std::string& filePath)
+	{
+		const int fileDescriptor{ open(filePath.c_str(), O_RDONLY) };
+		if (fileDescriptor < 0) return;
+
+		struct stat fileStatus {};
+		if (fstat(fileDescriptor, &fileStatus) == 0)
+		{
+			m_Size = static_cast<size_t>(fileStatus.st_size);
+			if (m_Size == 0)
+			{
+				m_IsOpen = true;
+			}
+			else
+			{
+				void* pMapping{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0) };
+				if (pMapping != MAP_FAILED)
+				{
+					madvise(pMapping, m_Size, MADV_SEQUENTIAL);
+					m_pData = static_cast<const char*>(pMapping);
+					m_IsOpen = true;
+				}
+			}
+		}
+
+		// the mapping keeps its own reference to the file
+		close(fileDescriptor);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_pData) munmap(const_cast<char*>(m_pData), m_Size);
+	}
+#endif
+}
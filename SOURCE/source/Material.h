@@ -5,11 +5,145 @@
 
 namespace dae
 {
+#pragma region Material DATA
+	// Shading variant of a material, picked once when it is created so shading doesn't branch on its parameters
+	enum class MaterialType : unsigned char
+	{
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		LambertPhongIntegerExponent,
+		CookTorrenceMetal,
+		CookTorrenceDielectric
+	};
+
+	// Plain parameters of every material type in one flat struct, the scene keeps them in a table (Scene::GetMaterialTable)
+	// indexed by HitRecord::materialIndex, so shading is a switch on the type instead of a virtual call per light per pixel
+	struct MaterialData
+	{
+		MaterialType type{ MaterialType::SolidColor };
+
+		ColorRGB color{};				// solid color, diffuse color (cd) or albedo (Cook-Torrance)
+		float diffuseReflectance{};		// kd
+		float specularReflectance{};	// ks
+		float phongExponent{};
+		float metalness{};
+		float roughness{};				// [1.0 > 0.0] >> [ROUGH > SMOOTH]
+
+		// derived from the above by the Material classes
+		ColorRGB diffuse{};				// Lambert term: cd * kd / PI, albedo / PI for Cook-Torrance
+		ColorRGB f0{};					// Cook-Torrance base reflectivity
+		float alphaSquared{};			// BRDF::GGX_AlphaSquared(roughness)
+		float smithK{};					// BRDF::Smith_K(roughness)
+	};
+
+	/**
+	 * \brief Shading of the specific material types, see ShadeMaterial
+	 * \param material parameters (type has to match)
+	 * \param hitRecord current hitrecord
+	 * \param l light direction
+	 * \param v view direction
+	 * \return color
+	 */
+	inline ColorRGB Shade_SolidColor(const MaterialData& material)
+	{
+		return material.color;
+	}
+
+	inline ColorRGB Shade_Lambert(const MaterialData& material)
+	{
+		return material.diffuse;
+	}
+
+	template<bool integerExponent>
+	inline ColorRGB Shade_LambertPhong(const MaterialData& material, const HitRecord& hitRecord, const Vector3& l, const Vector3& v)
+	{
+		return
+		{
+			material.diffuse
+			+
+			BRDF::Phong<integerExponent>(material.specularReflectance, material.phongExponent, l, v, hitRecord.normal)
+		};
+	}
+
+	template<bool isMetal>
+	inline ColorRGB Shade_CookTorrence(const MaterialData& material, const HitRecord& hitRecord, const Vector3& l, const Vector3& v)
+	{
+		return BRDF::CookTorrence<isMetal>(material.f0, material.diffuse, material.alphaSquared, material.smithK, hitRecord.normal, l, v);
+	}
+
+	inline ColorRGB ShadeMaterial(const MaterialData& material, const HitRecord& hitRecord, const Vector3& l, const Vector3& v)
+	{
+		switch (material.type)
+		{
+		case MaterialType::SolidColor:
+			return Shade_SolidColor(material);
+
+		case MaterialType::Lambert:
+			return Shade_Lambert(material);
+
+		case MaterialType::LambertPhong:
+			return Shade_LambertPhong<false>(material, hitRecord, l, v);
+
+		case MaterialType::LambertPhongIntegerExponent:
+			return Shade_LambertPhong<true>(material, hitRecord, l, v);
+
+		case MaterialType::CookTorrenceMetal:
+			return Shade_CookTorrence<true>(material, hitRecord, l, v);
+
+		case MaterialType::CookTorrenceDielectric:
+			return Shade_CookTorrence<false>(material, hitRecord, l, v);
+		}
+		return {};
+	}
+
+	/**
+	 * \brief ShadeMaterial for a batch of (normal, light, view) tuples that all hit this material
+	 * \param material parameters
+	 * \param batch tuples to shade
+	 * \param colors receives the color per lane
+	 */
+	inline void ShadeMaterial_Batch(const MaterialData& material, const BRDF::ShadingBatch& batch, BRDF::ColorBatch& colors)
+	{
+		switch (material.type)
+		{
+		case MaterialType::SolidColor:
+			colors.Fill(Shade_SolidColor(material), batch.count);
+			return;
+
+		case MaterialType::Lambert:
+			colors.Fill(Shade_Lambert(material), batch.count);
+			return;
+
+		case MaterialType::LambertPhong:
+			BRDF::LambertPhong_Batch<false>(material.diffuse, material.specularReflectance, material.phongExponent, batch, colors);
+			return;
+
+		case MaterialType::LambertPhongIntegerExponent:
+			BRDF::LambertPhong_Batch<true>(material.diffuse, material.specularReflectance, material.phongExponent, batch, colors);
+			return;
+
+		case MaterialType::CookTorrenceMetal:
+			BRDF::CookTorrence_Batch<true>(material.f0, material.diffuse, material.alphaSquared, material.smithK, batch, colors);
+			return;
+
+		case MaterialType::CookTorrenceDielectric:
+			BRDF::CookTorrence_Batch<false>(material.f0, material.diffuse, material.alphaSquared, material.smithK, batch, colors);
+			return;
+		}
+		colors.Fill({}, batch.count);
+	}
+#pragma endregion
+
 #pragma region Material BASE
+	// Scene side description of a material (Scene::AddMaterial), the derived classes only fill in the MaterialData
 	class Material
 	{
 	public:
-		Material() = default;
+		explicit Material(const MaterialData& data)
+			: m_Data{ data }
+		{
+		}
 		virtual ~Material() = default;
 
 		Material(const Material&) = delete;
@@ -24,8 +158,15 @@ namespace dae
 		 * \param v view direction
 		 * \return color
 		 */
+		const ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
+		{
+			return ShadeMaterial(m_Data, hitRecord, l, v);
+		}
 
-		virtual const ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+		const MaterialData& GetData() const { return m_Data; }
+
+	protected:
+		MaterialData m_Data;
 	};
 #pragma endregion
 
@@ -36,17 +177,9 @@ namespace dae
 	{
 	public:
 		Material_SolidColor(const ColorRGB& color)
-			: m_Color{ color }
+			: Material{ { MaterialType::SolidColor, color } }
 		{
 		}
-
-		const ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
-		{
-			return m_Color;
-		}
-
-	private:
-		ColorRGB m_Color;
 	};
 #pragma endregion
 
@@ -56,19 +189,18 @@ namespace dae
 	class Material_Lambert final : public Material
 	{
 	public:
-		Material_Lambert(const ColorRGB& diffuseColor, const float diffuseReflectance) 
-			: m_DiffuseColor{ diffuseColor } /*cd*/, m_DiffuseReflectance{ diffuseReflectance }
+		Material_Lambert(const ColorRGB& diffuseColor, const float diffuseReflectance)
+			: Material{ CreateData(diffuseColor, diffuseReflectance) }
 		{
 		}
 
-		const ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+	private:
+		static MaterialData CreateData(const ColorRGB& diffuseColor, const float diffuseReflectance)
 		{
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
+			MaterialData data{ MaterialType::Lambert, diffuseColor /*cd*/, diffuseReflectance /*kd*/ };
+			data.diffuse = BRDF::Lambert(diffuseReflectance, diffuseColor);
+			return data;
 		}
-
-	private:
-		ColorRGB m_DiffuseColor;
-		float m_DiffuseReflectance; //kd
 	};
 #pragma endregion
 
@@ -79,26 +211,21 @@ namespace dae
 	{
 	public:
 		Material_LambertPhong(const ColorRGB& diffuseColor, const float kd, const float ks, const float phongExponent)
-			: m_DiffuseColor{ diffuseColor }, m_DiffuseReflectance{ kd }, m_SpecularReflectance{ ks },
-			  m_PhongExponent{ phongExponent }
+			: Material{ CreateData(diffuseColor, kd, ks, phongExponent) }
 		{
 		}
 
-		const ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+	private:
+		static MaterialData CreateData(const ColorRGB& diffuseColor, const float kd, const float ks, const float phongExponent)
 		{
-			return 
-			{ 
-				BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor) 
-				+ 
-				BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, v, hitRecord.normal)
-			};
-		}
+			// whole exponents get the powf free variant, the cap keeps the squaring loop short
+			constexpr float maxIntegerExponent{ 1024.f };
+			const bool isIntegerExponent{ phongExponent >= 0.f && phongExponent <= maxIntegerExponent && phongExponent == std::floor(phongExponent) };
 
-	private:
-		ColorRGB m_DiffuseColor;
-		float m_DiffuseReflectance; //kd
-		float m_SpecularReflectance; //ks
-		float m_PhongExponent; //Phong Exponent
+			MaterialData data{ isIntegerExponent ? MaterialType::LambertPhongIntegerExponent : MaterialType::LambertPhong, diffuseColor, kd, ks, phongExponent };
+			data.diffuse = BRDF::Lambert(kd, diffuseColor);
+			return data;
+		}
 	};
 #pragma endregion
 
@@ -108,41 +235,25 @@ namespace dae
 	{
 	public:
 		Material_CookTorrence(const ColorRGB& albedo, const float metalness, const float roughness)
-			: m_Albedo{ albedo }, m_Metalness{ metalness }, m_Roughness{ roughness }
+			: Material{ CreateData(albedo, metalness, roughness) }
 		{
 		}
 
-		const ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+	private:
+		static MaterialData CreateData(const ColorRGB& albedo, const float metalness, const float roughness)
 		{
-			if (m_Roughness < FLT_EPSILON) return{};
-
-			const ColorRGB	f0 = m_Metalness ? m_Albedo : ColorRGB{ 0.04f, 0.04f, 0.04f };
-			const Vector3	h{ (v + l).Normalized() };
-
-			const ColorRGB	F{ BRDF::FresnelFunction_Schlick(h, v, f0) };
-			const float		D{ BRDF::NormalDistribution_GGX(hitRecord.normal, h, m_Roughness) };
-			const float		G{ BRDF::GeometryFunction_Smith(hitRecord.normal, v, l, m_Roughness) };
-
-			ColorRGB lambert{};
-			if (!m_Metalness)
-			{
-				ColorRGB kd{ 1.f - F };
-				lambert = BRDF::Lambert(kd, m_Albedo);
-			}
+			// a perfectly smooth surface has no GGX lobe to evaluate, it is shaded black
+			if (roughness < FLT_EPSILON) return { MaterialType::SolidColor, ColorRGB{}, 0.f, 0.f, 0.f, metalness, roughness };
 
-			if (FloatIsZero(F.r) || FloatIsZero(D) || FloatIsZero(G)) return lambert;
+			const bool isMetal{ metalness != 0.f };
 
-			const ColorRGB	DFG{ D * F * G  };
-			const float vnln4{ 4.f * Vector3::Dot(v, hitRecord.normal) * Vector3::Dot(l, hitRecord.normal) };
-			const ColorRGB	specular{ DFG / vnln4 };
-
-			return { lambert + specular };
+			MaterialData data{ isMetal ? MaterialType::CookTorrenceMetal : MaterialType::CookTorrenceDielectric, albedo, 0.f, 0.f, 0.f, metalness, roughness };
+			data.diffuse = albedo * DIV_PI;
+			data.f0 = isMetal ? albedo : ColorRGB{ 0.04f, 0.04f, 0.04f };
+			data.alphaSquared = BRDF::GGX_AlphaSquared(roughness);
+			data.smithK = BRDF::Smith_K(roughness);
+			return data;
 		}
-
-	private:
-		ColorRGB m_Albedo; // material specific
-		float m_Metalness;
-		float m_Roughness; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
 	};
 #pragma endregion
 }
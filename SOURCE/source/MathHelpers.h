@@ -2,6 +2,12 @@
 #include <cmath>
 #include <float.h>
 
+// SSE paths for the hot traversal loops, define DAE_NO_SIMD to build the scalar fallback
+#if !defined(DAE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define DAE_SIMD_SSE
+#include <immintrin.h>
+#endif
+
 namespace dae
 {
 	/* --- CONSTANTS --- */
@@ -23,6 +29,19 @@ namespace dae
 		return a * a;
 	}
 
+	// base^exponent by repeated squaring, for whole exponents known up front (see Material_LambertPhong)
+	inline const float PowInteger(float base, unsigned int exponent)
+	{
+		float result{ 1.f };
+		while (exponent > 0)
+		{
+			if (exponent & 1u) result *= base;
+			base *= base;
+			exponent >>= 1u;
+		}
+		return result;
+	}
+
 	inline const float Lerpf(const float a, const float b, const float factor)
 	{
 		return (1 - factor) * a + (factor * b);
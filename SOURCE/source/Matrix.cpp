@@ -39,53 +39,75 @@ namespace dae {
 		data[3] = m[3];
 	}
 
-	const Vector3 Matrix::TransformVector(const Vector3& v) const
-	{
-		return TransformVector(v[0], v[1], v[2]);
-	}
-
-	const Vector3 Matrix::TransformVector(const float x, const float y, const float z) const
+	const Matrix& Matrix::Transpose()
 	{
-		return Vector3
+		const int nrOfVectorsInMatrix{ 4 };
+		for (int r{ 0 }; r < nrOfVectorsInMatrix; ++r)
 		{
-			data[0].x * x + data[1].x * y + data[2].x * z,
-			data[0].y * x + data[1].y * y + data[2].y * z,
-			data[0].z * x + data[1].z * y + data[2].z * z
-		};
+			for (int c{ r + 1 }; c < nrOfVectorsInMatrix; ++c)
+			{
+				std::swap(data[r][c], data[c][r]);
+			}
+		}
+
+		return *this;
 	}
 
-	const Vector3 Matrix::TransformPoint(const Vector3& p) const
+	const Matrix Matrix::Transpose(Matrix m)
 	{
-		return TransformPoint(p[0], p[1], p[2]);
+		return m.Transpose();
 	}
 
-	const Vector3 Matrix::TransformPoint(const float x, const float y, const float z) const
+	const Matrix& Matrix::Inverse()
 	{
-		return Vector3
+		// cofactor expansion of the full 4x4 matrix
+		float m[16];
+		for (int r{ 0 }; r < 4; ++r)
 		{
-			data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
-			data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
-			data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
-		};
-	}
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				m[r * 4 + c] = data[r][c];
+			}
+		}
 
-	const Matrix& Matrix::Transpose()
-	{
-		const int nrOfVectorsInMatrix{ 4 };
-		for (int r{ 0 }; r < nrOfVectorsInMatrix; ++r)
+		float inv[16];
+		inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+		inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+		inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+		inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+		inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+		inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+		inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+		inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+		inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+		inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+		inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+		inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+		inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+		inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+		inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+		inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+		const float determinant{ m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12] };
+
+		// singular matrix (zero scale), can't be right
+		assert(!FloatIsZero(determinant));
+		const float invDeterminant{ 1.f / determinant };
+
+		for (int r{ 0 }; r < 4; ++r)
 		{
-			for (int c{ r + 1 }; c < nrOfVectorsInMatrix; ++c)
+			for (int c{ 0 }; c < 4; ++c)
 			{
-				std::swap(data[r][c], data[c][r]);
+				data[r][c] = inv[r * 4 + c] * invDeterminant;
 			}
 		}
 
 		return *this;
 	}
 
-	const Matrix Matrix::Transpose(Matrix m)
+	const Matrix Matrix::Inverse(Matrix m)
 	{
-		return m.Transpose();
+		return m.Inverse();
 	}
 
 	const Vector3 Matrix::GetAxisX() const
@@ -236,5 +258,22 @@ namespace dae {
 
 		return *this;
 	}
+	bool Matrix::operator==(const Matrix& m) const
+	{
+		for (int r{ 0 }; r < 4; ++r)
+		{
+			for (int c{ 0 }; c < 4; ++c)
+			{
+				if (data[r][c] != m.data[r][c]) return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool Matrix::operator!=(const Matrix& m) const
+	{
+		return !(*this == m);
+	}
 #pragma endregion
 }
\ No newline at end of file
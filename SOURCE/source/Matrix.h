@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Vector3.h"
 #include "Vector4.h"
 
 namespace dae {
@@ -29,6 +30,7 @@ namespace dae {
 		const Vector3 TransformPoint(const Vector3& p) const;
 		const Vector3 TransformPoint(const float x, const float y, const float z) const;
 		const Matrix& Transpose();
+		const Matrix& Inverse();
 
 		const Vector3 GetAxisX() const;
 		const Vector3 GetAxisY() const;
@@ -45,11 +47,14 @@ namespace dae {
 		static const Matrix CreateScale(const float sx, const float sy, const float sz);
 		static const Matrix CreateScale(const Vector3& s);
 		static const Matrix Transpose(Matrix m);
+		static const Matrix Inverse(Matrix m);
 
 		Vector4& operator[](int index);
 		Vector4 operator[](int index) const;
 		Matrix operator*(const Matrix& m) const;
 		const Matrix& operator*=(const Matrix& m);
+		bool operator==(const Matrix& m) const;
+		bool operator!=(const Matrix& m) const;
 
 	private:
 
@@ -61,4 +66,37 @@ namespace dae {
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
 	};
+
+#pragma region Inline Transforms
+	// called for every ray (camera and object space transforms), kept inline
+	inline const Vector3 Matrix::TransformVector(const Vector3& v) const
+	{
+		return TransformVector(v.x, v.y, v.z);
+	}
+
+	inline const Vector3 Matrix::TransformVector(const float x, const float y, const float z) const
+	{
+		return Vector3
+		{
+			data[0].x * x + data[1].x * y + data[2].x * z,
+			data[0].y * x + data[1].y * y + data[2].y * z,
+			data[0].z * x + data[1].z * y + data[2].z * z
+		};
+	}
+
+	inline const Vector3 Matrix::TransformPoint(const Vector3& p) const
+	{
+		return TransformPoint(p.x, p.y, p.z);
+	}
+
+	inline const Vector3 Matrix::TransformPoint(const float x, const float y, const float z) const
+	{
+		return Vector3
+		{
+			data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+			data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+			data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+		};
+	}
+#pragma endregion
 }
\ No newline at end of file
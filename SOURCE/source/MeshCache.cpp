@@ -0,0 +1,426 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "MeshCache.h"
+#include "DataTypes.h"
+#include "MappedFile.h"
+#include "OBJParser.h"
+
+namespace dae
+{
+	namespace
+	{
+		// bump on any layout change of the headers, the arrays, Vector3 or BVHNode
+		constexpr uint32_t meshCacheVersion{ 2 };
+		constexpr char meshCacheMagic[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+		constexpr uint32_t bvhCacheVersion{ 1 };
+		constexpr char bvhCacheMagic[8]{ 'D', 'A', 'E', 'B', 'V', 'H', '\0', '\0' };
+		constexpr size_t arrayAlignment{ 16 };
+
+		// Raw in-memory layout of the arrays (native endianness), the cache is a local file, not an exchange format
+		struct MeshCacheHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t vector3Size;
+
+			uint64_t sourceSize;
+			int64_t sourceWriteTime;
+
+			uint64_t nrPositions;
+			uint64_t nrNormals;
+			uint64_t nrIndices;
+
+			Vector3 minAABB;
+			Vector3 maxAABB;
+		};
+
+		// Hierarchies are keyed on what they were built from (vertex/index content + build settings), not on the file
+		struct BVHCacheHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t nodeSize;
+
+			uint64_t contentHash;
+			uint64_t buildSettingsHash;
+
+			uint64_t nrTriangles;
+			uint64_t nrNodes;
+			uint64_t nrPrimitiveIndices;
+		};
+
+		enum class BVHCacheResult
+		{
+			Missing,
+			Stale,		// built from other content/settings, but for the same number of triangles (topology can be refitted)
+			Valid
+		};
+
+		struct SourceStamp
+		{
+			uint64_t size{};
+			int64_t writeTime{};
+		};
+
+		bool GetSourceStamp(const std::string& filename, SourceStamp& stamp)
+		{
+			std::error_code error{};
+			stamp.size = static_cast<uint64_t>(std::filesystem::file_size(filename, error));
+			if (error) return false;
+
+			stamp.writeTime = static_cast<int64_t>(std::filesystem::last_write_time(filename, error).time_since_epoch().count());
+			return !error;
+		}
+
+		size_t AlignArrayOffset(const size_t offset)
+		{
+			return (offset + arrayAlignment - 1) / arrayAlignment * arrayAlignment;
+		}
+
+		// write next to it and rename, a crash halfway never leaves a broken cache behind
+		// the caches are only an optimisation, failing to store one is not an error
+		void ReplaceCacheFile(const std::string& temporaryFilename, const std::string& cacheFilename)
+		{
+			std::error_code error{};
+			std::filesystem::rename(temporaryFilename, cacheFilename, error);
+			if (error) std::filesystem::remove(temporaryFilename, error);
+		}
+
+		template<typename T>
+		bool ReadArray(const MappedFile& file, size_t& offset, const uint64_t count, std::vector<T>& destination)
+		{
+			offset = AlignArrayOffset(offset);
+
+			// count comes from the file, compare it against the room left instead of multiplying (which can wrap)
+			if (offset > file.GetSize() || count > (file.GetSize() - offset) / sizeof(T)) return false;
+			const uint64_t nrBytes{ count * sizeof(T) };
+
+			const T* pBegin{ reinterpret_cast<const T*>(file.GetData() + offset) };
+			destination.assign(pBegin, pBegin + count);
+
+			offset += static_cast<size_t>(nrBytes);
+			return true;
+		}
+
+		template<typename T>
+		void WriteArray(std::ofstream& file, const std::vector<T>& source)
+		{
+			const std::streamoff position{ file.tellp() };
+			const size_t nrPaddingBytes{ AlignArrayOffset(static_cast<size_t>(position)) - static_cast<size_t>(position) };
+
+			const char padding[arrayAlignment]{};
+			file.write(padding, nrPaddingBytes);
+			file.write(reinterpret_cast<const char*>(source.data()), static_cast<std::streamsize>(source.size() * sizeof(T)));
+		}
+
+		// the same checks the OBJ parser applies: whole triangles, one face normal per triangle and every index naming a position
+		bool IsGeometryConsistent(const TriangleMeshGeometry& geometry)
+		{
+			if (geometry.indices.size() % 3 != 0 || geometry.normals.size() != geometry.indices.size() / 3) return false;
+
+			const int nrPositions{ static_cast<int>(geometry.positions.size()) };
+			return std::all_of(geometry.indices.begin(), geometry.indices.end(), [nrPositions](const int index)
+			{
+				return index >= 0 && index < nrPositions;
+			});
+		}
+
+		bool ReadMeshCache(const std::string& cacheFilename, const SourceStamp& stamp, TriangleMeshGeometry& geometry)
+		{
+			const MappedFile file{ cacheFilename };
+			if (!file.IsOpen() || file.GetSize() < sizeof(MeshCacheHeader)) return false;
+
+			MeshCacheHeader header{};
+			std::memcpy(&header, file.GetData(), sizeof(MeshCacheHeader));
+
+			if (std::memcmp(header.magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 ||
+				header.version != meshCacheVersion ||
+				header.vector3Size != sizeof(Vector3) ||
+				header.sourceSize != stamp.size ||
+				header.sourceWriteTime != stamp.writeTime)
+			{
+				return false;
+			}
+
+			size_t offset{ sizeof(MeshCacheHeader) };
+			const bool isValid
+			{
+				ReadArray(file, offset, header.nrPositions, geometry.positions) &&
+				ReadArray(file, offset, header.nrNormals, geometry.normals) &&
+				ReadArray(file, offset, header.nrIndices, geometry.indices) &&
+				IsGeometryConsistent(geometry)
+			};
+
+			if (!isValid)
+			{
+				geometry.positions.clear();
+				geometry.normals.clear();
+				geometry.indices.clear();
+				return false;
+			}
+
+			geometry.minAABB = header.minAABB;
+			geometry.maxAABB = header.maxAABB;
+			return true;
+		}
+
+		void WriteMeshCache(const std::string& cacheFilename, const SourceStamp& stamp, const TriangleMeshGeometry& geometry)
+		{
+			MeshCacheHeader header{};
+			std::memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+			header.version = meshCacheVersion;
+			header.vector3Size = sizeof(Vector3);
+			header.sourceSize = stamp.size;
+			header.sourceWriteTime = stamp.writeTime;
+			header.nrPositions = geometry.positions.size();
+			header.nrNormals = geometry.normals.size();
+			header.nrIndices = geometry.indices.size();
+			header.minAABB = geometry.minAABB;
+			header.maxAABB = geometry.maxAABB;
+
+			const std::string temporaryFilename{ cacheFilename + ".tmp" };
+			{
+				std::ofstream file{ temporaryFilename, std::ios::binary | std::ios::trunc };
+				if (!file) return;
+
+				file.write(reinterpret_cast<const char*>(&header), sizeof(MeshCacheHeader));
+				WriteArray(file, geometry.positions);
+				WriteArray(file, geometry.normals);
+				WriteArray(file, geometry.indices);
+
+				if (!file) return;
+			}
+
+			ReplaceCacheFile(temporaryFilename, cacheFilename);
+		}
+
+		// 64 bit FNV-1a over 8 byte words + a final mix, fast enough to hash hundreds of MB at load time
+		uint64_t HashBytes(const void* pData, const size_t nrBytes, uint64_t hash)
+		{
+			const char* pBytes{ static_cast<const char*>(pData) };
+			size_t byteIdx{};
+
+			for (; byteIdx + sizeof(uint64_t) <= nrBytes; byteIdx += sizeof(uint64_t))
+			{
+				uint64_t word;
+				std::memcpy(&word, pBytes + byteIdx, sizeof(uint64_t));
+				hash = (hash ^ word) * 0x100000001b3ull;
+			}
+			for (; byteIdx < nrBytes; ++byteIdx)
+			{
+				hash = (hash ^ static_cast<unsigned char>(pBytes[byteIdx])) * 0x100000001b3ull;
+			}
+
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		uint64_t HashMeshContent(const TriangleMeshGeometry& geometry)
+		{
+			uint64_t hash{ 0xcbf29ce484222325ull };
+			hash = HashBytes(geometry.positions.data(), geometry.positions.size() * sizeof(Vector3), hash);
+			hash = HashBytes(geometry.indices.data(), geometry.indices.size() * sizeof(int), hash);
+			return hash;
+		}
+
+		// Walks the hierarchy from the root: every node has to be reached exactly once (a tree, not a graph sharing subtrees)
+		// and no deeper than BVH::maxDepth, the traversal stacks are sized for that. Its leaves together have to reference
+		// every triangle exactly once, or some would go missing from the triangle records. Expects all indices to be in range
+		bool IsWellFormedTree(const BVH& bvh)
+		{
+			struct NodeDepth
+			{
+				uint32_t nodeIdx;
+				uint32_t depth;
+			};
+
+			std::vector<bool> isVisited(bvh.nodes.size(), false);
+			std::vector<bool> isTriangleReferenced(bvh.primitiveIndices.size(), false);
+			size_t nrReferencedTriangles{};
+
+			std::vector<NodeDepth> stack{ NodeDepth{ 0, 0 } };
+			while (!stack.empty())
+			{
+				const NodeDepth current{ stack.back() };
+				stack.pop_back();
+
+				if (current.depth > BVH::maxDepth || isVisited[current.nodeIdx]) return false;
+				isVisited[current.nodeIdx] = true;
+
+				const BVHNode& node{ bvh.nodes[current.nodeIdx] };
+				if (node.IsLeaf())
+				{
+					for (uint32_t idx{ node.leftFirst }; idx < node.leftFirst + node.primitiveCount; ++idx)
+					{
+						const uint32_t primitiveIdx{ bvh.primitiveIndices[idx] };
+						if (isTriangleReferenced[primitiveIdx]) return false;
+						isTriangleReferenced[primitiveIdx] = true;
+					}
+					nrReferencedTriangles += node.primitiveCount;
+					continue;
+				}
+
+				stack.emplace_back(NodeDepth{ node.leftFirst, current.depth + 1 });
+				stack.emplace_back(NodeDepth{ node.leftFirst + 1, current.depth + 1 });
+			}
+			return nrReferencedTriangles == bvh.primitiveIndices.size();
+		}
+
+		BVHCacheResult ReadBVHCache(const std::string& cacheFilename, const uint64_t contentHash, const uint64_t nrTriangles, BVH& bvh)
+		{
+			const MappedFile file{ cacheFilename };
+			if (!file.IsOpen() || file.GetSize() < sizeof(BVHCacheHeader)) return BVHCacheResult::Missing;
+
+			BVHCacheHeader header{};
+			std::memcpy(&header, file.GetData(), sizeof(BVHCacheHeader));
+
+			if (std::memcmp(header.magic, bvhCacheMagic, sizeof(bvhCacheMagic)) != 0 ||
+				header.version != bvhCacheVersion ||
+				header.nodeSize != sizeof(BVHNode) ||
+				header.nrTriangles != nrTriangles ||
+				header.nrPrimitiveIndices != nrTriangles)
+			{
+				return BVHCacheResult::Missing;
+			}
+
+			size_t offset{ sizeof(BVHCacheHeader) };
+			if (!ReadArray(file, offset, header.nrNodes, bvh.nodes) || !ReadArray(file, offset, header.nrPrimitiveIndices, bvh.primitiveIndices))
+			{
+				bvh.Clear();
+				return BVHCacheResult::Missing;
+			}
+
+			// a corrupt file must never send the traversal out of bounds, in circles (children always come after their parent)
+			// or past the end of its fixed size stacks
+			const bool isConsistent
+			{
+				!bvh.nodes.empty() &&
+				std::all_of(bvh.nodes.begin(), bvh.nodes.end(), [&](const BVHNode& node)
+				{
+					if (node.IsLeaf()) return uint64_t{ node.leftFirst } + node.primitiveCount <= bvh.primitiveIndices.size();
+
+					const size_t nodeIdx{ static_cast<size_t>(&node - bvh.nodes.data()) };
+					return node.leftFirst > nodeIdx && uint64_t{ node.leftFirst } + 1 < bvh.nodes.size();
+				}) &&
+				std::all_of(bvh.primitiveIndices.begin(), bvh.primitiveIndices.end(), [&](const uint32_t primitiveIdx)
+				{
+					return primitiveIdx < nrTriangles;
+				}) &&
+				IsWellFormedTree(bvh)
+			};
+			if (!isConsistent)
+			{
+				bvh.Clear();
+				return BVHCacheResult::Missing;
+			}
+
+			bvh.UpdateWideNodes();
+
+			const bool isUpToDate{ header.contentHash == contentHash && header.buildSettingsHash == BVH::GetBuildSettingsHash() };
+			return isUpToDate ? BVHCacheResult::Valid : BVHCacheResult::Stale;
+		}
+
+		void WriteBVHCache(const std::string& cacheFilename, const uint64_t contentHash, const uint64_t nrTriangles, const BVH& bvh)
+		{
+			BVHCacheHeader header{};
+			std::memcpy(header.magic, bvhCacheMagic, sizeof(bvhCacheMagic));
+			header.version = bvhCacheVersion;
+			header.nodeSize = sizeof(BVHNode);
+			header.contentHash = contentHash;
+			header.buildSettingsHash = BVH::GetBuildSettingsHash();
+			header.nrTriangles = nrTriangles;
+			header.nrNodes = bvh.nodes.size();
+			header.nrPrimitiveIndices = bvh.primitiveIndices.size();
+
+			const std::string temporaryFilename{ cacheFilename + ".tmp" };
+			{
+				std::ofstream file{ temporaryFilename, std::ios::binary | std::ios::trunc };
+				if (!file) return;
+
+				file.write(reinterpret_cast<const char*>(&header), sizeof(BVHCacheHeader));
+				WriteArray(file, bvh.nodes);
+				WriteArray(file, bvh.primitiveIndices);
+
+				if (!file) return;
+			}
+
+			ReplaceCacheFile(temporaryFilename, cacheFilename);
+		}
+
+		void LoadBVH(const std::string& cacheFilename, TriangleMeshGeometry& geometry, ThreadPool* pThreadPool)
+		{
+			const uint64_t contentHash{ HashMeshContent(geometry) };
+			const uint64_t nrTriangles{ geometry.indices.size() / 3 };
+
+			switch (ReadBVHCache(cacheFilename, contentHash, nrTriangles, geometry.bvh))
+			{
+			case BVHCacheResult::Valid:
+				geometry.UpdateTriangleRecords();
+				return;
+
+			case BVHCacheResult::Stale:
+			{
+				// usable right away after a refit (same triangle count), the proper build runs in the background
+				// and is swapped in by Scene::UpdateTopLevelBVH, the worker also stores the new cache
+				geometry.RefitBVH();
+
+				geometry.pendingBVH = std::async(std::launch::async,
+					[positions = geometry.positions, indices = geometry.indices, cacheFilename, contentHash, nrTriangles]()
+					{
+						BVH bvh{};
+						bvh.BuildTriangles(positions, indices);
+						WriteBVHCache(cacheFilename, contentHash, nrTriangles, bvh);
+						return bvh;
+					});
+				return;
+			}
+
+			case BVHCacheResult::Missing:
+				// the cache only holds SAH hierarchies, whatever the geometry's build mode
+				geometry.bvh.BuildTriangles(geometry.positions, geometry.indices, pThreadPool);
+				WriteBVHCache(cacheFilename, contentHash, nrTriangles, geometry.bvh);
+				geometry.UpdateTriangleRecords();
+				return;
+			}
+		}
+	}
+
+	namespace Utils
+	{
+		bool LoadMesh(const std::string& filename, TriangleMeshGeometry& geometry, ThreadPool* pThreadPool)
+		{
+			SourceStamp stamp{};
+			if (!GetSourceStamp(filename, stamp)) return false;
+
+			// the caches replace the geometry, only use them for empty geometry (ParseOBJ appends)
+			const bool isEmpty{ geometry.positions.empty() && geometry.indices.empty() };
+			if (!isEmpty)
+			{
+				if (!ParseOBJ(filename, geometry.positions, geometry.normals, geometry.indices, pThreadPool)) return false;
+
+				geometry.UpdateAABB();
+				geometry.BuildBVH(pThreadPool);
+				return true;
+			}
+
+			const std::string meshCacheFilename{ filename + ".meshcache" };
+			if (!ReadMeshCache(meshCacheFilename, stamp, geometry))
+			{
+				if (!ParseOBJ(filename, geometry.positions, geometry.normals, geometry.indices, pThreadPool)) return false;
+
+				geometry.UpdateAABB();
+				if (!geometry.indices.empty()) WriteMeshCache(meshCacheFilename, stamp, geometry);
+			}
+
+			// a touched but unchanged OBJ re-parses, but still finds its hierarchy through the content hash
+			if (!geometry.indices.empty()) LoadBVH(filename + ".bvhcache", geometry, pThreadPool);
+			return true;
+		}
+	}
+}
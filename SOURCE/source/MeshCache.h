@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	struct TriangleMeshGeometry;
+	class ThreadPool;
+
+	namespace Utils
+	{
+		// Loads an OBJ mesh (positions, indices, face normals, AABB and BVH) into geometry, through two caches next to the OBJ:
+		// filename + ".meshcache": the parsed geometry, memory mapped and bulk copied in, rebuilt when the OBJ's size or write time changes
+		// filename + ".bvhcache": the built hierarchy, keyed by a hash of the positions/indices and the BVH build settings
+		//   stale (same triangle count): refitted and used right away while a fresh build runs in the background (geometry.pendingBVH)
+		//   missing/unusable: built on the spot (on pThreadPool when given) and stored
+		bool LoadMesh(const std::string& filename, TriangleMeshGeometry& geometry, ThreadPool* pThreadPool = nullptr);
+	}
+}
@@ -0,0 +1,397 @@
+#include "MicroBenchmarks.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Material.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint32_t nrOfRepetitions{ 3 };	// the best one is reported, the others only warm up / absorb noise
+
+		// Milliseconds of the fastest of nrOfRepetitions runs of function
+		template<typename Function>
+		double TimeBest(const Function& function)
+		{
+			double bestMs{ DBL_MAX };
+			for (uint32_t repetitionIdx{}; repetitionIdx < nrOfRepetitions; ++repetitionIdx)
+			{
+				const auto startTime{ std::chrono::steady_clock::now() };
+				function();
+				const auto endTime{ std::chrono::steady_clock::now() };
+
+				bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(endTime - startTime).count());
+			}
+			return bestMs;
+		}
+
+#pragma region Triangles
+		constexpr uint32_t terrainSize{ 707 };			// quads per side, 2 * 707 * 707 ~ 1M triangles
+		constexpr uint32_t nrOfMeshRays{ 300'000 };
+		constexpr uint32_t nrOfKernelSamples{ 300'000 };
+		constexpr uint32_t kernelWindowSize{ 64 };		// consecutive leaf order triangles every kernel sample is tested against
+
+		// Rolling height field on a unit grid with some noise, deterministic so runs are comparable
+		std::shared_ptr<TriangleMeshGeometry> CreateTerrain(ThreadPool* pThreadPool)
+		{
+			std::mt19937 generator{ 17 };
+			std::uniform_real_distribution<float> noise{ -0.25f, 0.25f };
+
+			std::vector<Vector3> positions{};
+			positions.reserve((terrainSize + 1) * (terrainSize + 1));
+			for (uint32_t z{}; z <= terrainSize; ++z)
+			{
+				for (uint32_t x{}; x <= terrainSize; ++x)
+				{
+					const float height{ 8.f * sinf(x * 0.02f) * cosf(z * 0.015f) + 3.f * sinf((x + z) * 0.07f) + noise(generator) };
+					positions.emplace_back(Vector3{ static_cast<float>(x), height, static_cast<float>(z) });
+				}
+			}
+
+			std::vector<int> indices{};
+			indices.reserve(terrainSize * terrainSize * 6);
+			for (uint32_t z{}; z < terrainSize; ++z)
+			{
+				for (uint32_t x{}; x < terrainSize; ++x)
+				{
+					const int corner{ static_cast<int>(z * (terrainSize + 1) + x) };
+					const int nextRow{ corner + static_cast<int>(terrainSize) + 1 };
+
+					indices.insert(indices.end(), { corner, nextRow, corner + 1, corner + 1, nextRow, nextRow + 1 });
+				}
+			}
+
+			std::shared_ptr<TriangleMeshGeometry> pGeometry{ std::make_shared<TriangleMeshGeometry>(positions, indices) };
+			pGeometry->BuildBVH(pThreadPool);
+			return pGeometry;
+		}
+
+		// The triangle test before the records (plane hit, then an edge test per side, vertices fetched through the indices),
+		// kept here as the reference the record based GeometryUtils::HitTest_Triangle is measured against. No culling
+		bool HitTest_TriangleIndexed(const TriangleMeshGeometry& geometry, const size_t triangleIdx, const Ray& ray, HitRecord& hitRecord)
+		{
+			const size_t nrTrianglePoints{ 3 };
+
+			const Vector3& normal{ geometry.normals[triangleIdx] };
+
+			const float tempDot{ Vector3::Dot(normal, ray.direction) };
+
+			if (FloatIsZero(tempDot)) return false;
+
+			const Vector3& V0{ geometry.positions[geometry.indices[triangleIdx * nrTrianglePoints]] };
+
+			const float t{ Vector3::Dot((V0 - ray.origin), normal) / tempDot };
+
+			if (t <= ray.min || t >= ray.max || t >= hitRecord.t) return false;
+
+			const Vector3& V1{ geometry.positions[geometry.indices[triangleIdx * nrTrianglePoints + 1]] };
+			const Vector3& V2{ geometry.positions[geometry.indices[triangleIdx * nrTrianglePoints + 2]] };
+
+			const Vector3 hitOrigin{ ray.direction * t + ray.origin };
+
+			if (
+				(Vector3::Dot(Vector3::Cross(V1 - V0, hitOrigin - V0), normal) < 0.f) ||
+				(Vector3::Dot(Vector3::Cross(V2 - V1, hitOrigin - V1), normal) < 0.f) ||
+				(Vector3::Dot(Vector3::Cross(V0 - V2, hitOrigin - V2), normal) < 0.f)
+				) return false;
+
+			hitRecord.t = t;
+			return true;
+		}
+
+		struct KernelSample
+		{
+			Ray ray;
+			uint32_t firstRecordIdx;	// start of the window in leaf order
+		};
+
+		struct KernelResult
+		{
+			uint32_t nrOfHits{};
+			double distanceSum{};		// checksum, both tests should (nearly) agree
+		};
+
+		// Rays aimed at a random triangle of a random window, from above at a slant (like a camera looking over the terrain)
+		std::vector<KernelSample> CreateKernelSamples(const TriangleMeshGeometry& geometry)
+		{
+			std::mt19937 generator{ 1 };
+			std::uniform_int_distribution<uint32_t> windowStart{ 0, static_cast<uint32_t>(geometry.triangleRecords.size()) - kernelWindowSize };
+			std::uniform_int_distribution<uint32_t> windowOffset{ 0, kernelWindowSize - 1 };
+			std::uniform_real_distribution<float> offset{ -1.f, 1.f };
+
+			std::vector<KernelSample> samples{};
+			samples.reserve(nrOfKernelSamples);
+			for (uint32_t sampleIdx{}; sampleIdx < nrOfKernelSamples; ++sampleIdx)
+			{
+				const uint32_t firstRecordIdx{ windowStart(generator) };
+				const TriangleRecord& target{ geometry.triangleRecords[firstRecordIdx + windowOffset(generator)] };
+
+				const Vector3 centroid{ target.v0 + (target.edge1 + target.edge2) / 3.f };
+				const Vector3 origin{ centroid + Vector3{ offset(generator) * 20.f, 15.f, offset(generator) * 20.f } };
+
+				samples.emplace_back(KernelSample{ Ray{ origin, (centroid - origin).Normalized() }, firstRecordIdx });
+			}
+			return samples;
+		}
+
+		// Random rays from around the terrain towards its middle part, about half of them hit
+		std::vector<Ray> CreateMeshRays(const TriangleMeshGeometry& geometry)
+		{
+			std::mt19937 generator{ 2 };
+			std::uniform_real_distribution<float> offset{ -1.f, 1.f };
+
+			const Vector3 center{ (geometry.minAABB + geometry.maxAABB) * 0.5f };
+			const float extent{ (geometry.maxAABB - geometry.minAABB).Magnitude() };
+
+			std::vector<Ray> rays{};
+			rays.reserve(nrOfMeshRays);
+			for (uint32_t rayIdx{}; rayIdx < nrOfMeshRays; ++rayIdx)
+			{
+				const Vector3 origin{ center + Vector3{ offset(generator), offset(generator), offset(generator) } * extent };
+				const Vector3 target{ center + Vector3{ offset(generator), offset(generator), offset(generator) } * 0.3f * extent };
+
+				rays.emplace_back(Ray{ origin, (target - origin).Normalized() });
+			}
+			return rays;
+		}
+
+		void RunTriangles()
+		{
+			ThreadPool threadPool{};
+
+			const auto buildStartTime{ std::chrono::steady_clock::now() };
+			TriangleMesh mesh{ CreateTerrain(&threadPool), TriangleCullMode::NoCulling, 0 };
+			mesh.UpdateTransforms();
+			const auto buildEndTime{ std::chrono::steady_clock::now() };
+
+			const TriangleMeshGeometry& geometry{ *mesh.geometry };
+			const BVH& bvh{ geometry.bvh };
+
+			std::cout << "**MICROBENCHMARK** triangles: terrain of " << geometry.triangleRecords.size() << " triangles (generated and built in "
+				<< std::chrono::duration<double, std::milli>(buildEndTime - buildStartTime).count() << " ms)\n";
+
+			// both tests over the same leaf order windows, the indexed one goes through primitiveIndices like the old leaf loop did
+			const std::vector<KernelSample> samples{ CreateKernelSamples(geometry) };
+			const double nrOfTests{ static_cast<double>(nrOfKernelSamples) * kernelWindowSize };
+
+			KernelResult indexedResult{};
+			const double indexedMs
+			{
+				TimeBest([&]()
+				{
+					indexedResult = {};
+					for (const KernelSample& sample : samples)
+					{
+						HitRecord hitRecord{};
+						for (uint32_t idx{ sample.firstRecordIdx }; idx < sample.firstRecordIdx + kernelWindowSize; ++idx)
+						{
+							HitTest_TriangleIndexed(geometry, bvh.primitiveIndices[idx], sample.ray, hitRecord);
+						}
+						if (hitRecord.t < FLT_MAX)
+						{
+							++indexedResult.nrOfHits;
+							indexedResult.distanceSum += hitRecord.t;
+						}
+					}
+				})
+			};
+
+			KernelResult recordResult{};
+			const double recordMs
+			{
+				TimeBest([&]()
+				{
+					recordResult = {};
+					for (const KernelSample& sample : samples)
+					{
+						HitRecord hitRecord{};
+						for (uint32_t idx{ sample.firstRecordIdx }; idx < sample.firstRecordIdx + kernelWindowSize; ++idx)
+						{
+							GeometryUtils::HitTest_Triangle(mesh, idx, sample.ray, hitRecord);
+						}
+						if (hitRecord.t < FLT_MAX)
+						{
+							++recordResult.nrOfHits;
+							recordResult.distanceSum += hitRecord.t;
+						}
+					}
+				})
+			};
+
+			std::cout << ">> triangle test, " << nrOfKernelSamples << " rays x " << kernelWindowSize << " leaf order triangles:\n"
+				<< "   indexed (plane + edges): " << indexedMs * 1'000'000.0 / nrOfTests << " ns/test, "
+				<< indexedResult.nrOfHits << " hits (t sum " << indexedResult.distanceSum << ")\n"
+				<< "   record (Moller-Trumbore): " << recordMs * 1'000'000.0 / nrOfTests << " ns/test, "
+				<< recordResult.nrOfHits << " hits (t sum " << recordResult.distanceSum << ")\n";
+
+			// whole mesh through the hierarchy, as the renderer traces it (the record test is the only one it can use)
+			const std::vector<Ray> rays{ CreateMeshRays(geometry) };
+
+			uint32_t nrOfClosestHits{};
+			const double closestHitMs
+			{
+				TimeBest([&]()
+				{
+					nrOfClosestHits = 0;
+					for (const Ray& ray : rays)
+					{
+						HitRecord hitRecord{};
+						if (GeometryUtils::HitTest_TriangleMesh(mesh, 0, ray, hitRecord)) ++nrOfClosestHits;
+					}
+				})
+			};
+
+			uint32_t nrOfAnyHits{};
+			const double anyHitMs
+			{
+				TimeBest([&]()
+				{
+					nrOfAnyHits = 0;
+					for (const Ray& ray : rays)
+					{
+						if (GeometryUtils::HitTest_TriangleMesh(mesh, ray)) ++nrOfAnyHits;
+					}
+				})
+			};
+
+			std::cout << ">> mesh, " << nrOfMeshRays << " random rays: closest hit " << closestHitMs << " ms (" << nrOfClosestHits << " hits), "
+				<< "any hit " << anyHitMs << " ms (" << nrOfAnyHits << " hits)\n";
+		}
+#pragma endregion
+
+#pragma region Shading
+		constexpr uint32_t nrOfShadingRounds{ 100'000 };	// every round shades the whole batch once
+
+		struct ShadingMaterial
+		{
+			const char* name;
+			MaterialData data;
+		};
+
+		// One material per MaterialType, with the parameters the scenes use
+		std::vector<ShadingMaterial> CreateShadingMaterials()
+		{
+			const Material_Lambert lambert{ colors::White, 1.f };
+			const Material_LambertPhong phong{ colors::Blue, 0.5f, 0.5f, 15.5f };
+			const Material_LambertPhong phongInteger{ colors::Blue, 0.5f, 0.5f, 15.f };
+			const Material_CookTorrence metal{ { 0.972f, 0.960f, 0.915f }, 1.f, 0.6f };
+			const Material_CookTorrence dielectric{ { 0.75f, 0.75f, 0.75f }, 0.f, 0.6f };
+
+			return
+			{
+				{ "SolidColor", MaterialData{ MaterialType::SolidColor, colors::Red } },
+				{ "Lambert", lambert.GetData() },
+				{ "LambertPhong (exp 15.5)", phong.GetData() },
+				{ "LambertPhongIntegerExponent (exp 15)", phongInteger.GetData() },
+				{ "CookTorrenceMetal", metal.GetData() },
+				{ "CookTorrenceDielectric", dielectric.GetData() }
+			};
+		}
+
+		// Random (normal, light, view) tuples around +z with the light in front of the surface, like a lit pixel
+		void CreateShadingSamples(HitRecord (&hitRecords)[BRDF::shadingBatchSize], Vector3 (&lightDirections)[BRDF::shadingBatchSize],
+			Vector3 (&viewDirections)[BRDF::shadingBatchSize], BRDF::ShadingBatch& batch)
+		{
+			std::mt19937 generator{ 1 };
+			std::uniform_real_distribution<float> offset{ -1.f, 1.f };
+
+			for (uint32_t sampleIdx{}; sampleIdx < BRDF::shadingBatchSize; ++sampleIdx)
+			{
+				const Vector3 normal{ Vector3{ offset(generator) * 0.5f, offset(generator) * 0.5f, 1.f }.Normalized() };
+				const Vector3 lightDirection{ Vector3{ offset(generator), offset(generator), 1.f }.Normalized() };
+				const Vector3 viewDirection{ Vector3{ offset(generator), offset(generator), -0.5f }.Normalized() };
+
+				hitRecords[sampleIdx].normal = normal;
+				lightDirections[sampleIdx] = lightDirection;
+				viewDirections[sampleIdx] = viewDirection;
+				batch.Add(normal, lightDirection, viewDirection);
+			}
+		}
+
+		void RunShading()
+		{
+			HitRecord hitRecords[BRDF::shadingBatchSize]{};
+			Vector3 lightDirections[BRDF::shadingBatchSize]{};
+			Vector3 viewDirections[BRDF::shadingBatchSize]{};
+			BRDF::ShadingBatch batch{};
+			CreateShadingSamples(hitRecords, lightDirections, viewDirections, batch);
+
+			const double nrOfSamples{ static_cast<double>(nrOfShadingRounds) * BRDF::shadingBatchSize };
+
+			std::cout << "**MICROBENCHMARK** shading: " << BRDF::shadingBatchSize << " random (n, l, v) tuples, "
+				<< nrOfShadingRounds << " rounds, ns/sample single (ShadeMaterial) / batch (ShadeMaterial_Batch)\n";
+
+			for (const ShadingMaterial& material : CreateShadingMaterials())
+			{
+				float checksum{};	// keeps the results alive
+
+				const double singleMs
+				{
+					TimeBest([&]()
+					{
+						for (uint32_t roundIdx{}; roundIdx < nrOfShadingRounds; ++roundIdx)
+						{
+							for (uint32_t sampleIdx{}; sampleIdx < BRDF::shadingBatchSize; ++sampleIdx)
+							{
+								checksum += ShadeMaterial(material.data, hitRecords[sampleIdx], lightDirections[sampleIdx], viewDirections[sampleIdx]).b;
+							}
+						}
+					})
+				};
+
+				BRDF::ColorBatch colors{};
+				const double batchMs
+				{
+					TimeBest([&]()
+					{
+						for (uint32_t roundIdx{}; roundIdx < nrOfShadingRounds; ++roundIdx)
+						{
+							ShadeMaterial_Batch(material.data, batch, colors);
+							checksum += colors.b[roundIdx % BRDF::shadingBatchSize];
+						}
+					})
+				};
+
+				// both paths have to shade the same colors
+				float maxDifference{};
+				for (uint32_t sampleIdx{}; sampleIdx < BRDF::shadingBatchSize; ++sampleIdx)
+				{
+					const ColorRGB single{ ShadeMaterial(material.data, hitRecords[sampleIdx], lightDirections[sampleIdx], viewDirections[sampleIdx]) };
+					const ColorRGB batched{ colors.Get(sampleIdx) };
+					maxDifference = std::max({ maxDifference, std::abs(single.r - batched.r), std::abs(single.g - batched.g), std::abs(single.b - batched.b) });
+				}
+
+				std::cout << ">> " << material.name << ": " << singleMs * 1'000'000.0 / nrOfSamples << " / "
+					<< batchMs * 1'000'000.0 / nrOfSamples << " (max difference " << maxDifference << ", checksum " << checksum << ")\n";
+			}
+		}
+#pragma endregion
+	}
+
+	namespace MicroBenchmarks
+	{
+		bool Run(const std::string& name)
+		{
+			if (name == "triangles") RunTriangles();
+			else if (name == "shading") RunShading();
+			else return false;
+
+			return true;
+		}
+
+		void PrintNames()
+		{
+			std::cout << "Microbenchmarks: triangles, shading\n";
+		}
+	}
+}
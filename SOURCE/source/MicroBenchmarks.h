@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	// Timings of single kernels outside of any scene or renderer (RayTracer --microbenchmark name), so the numbers quoted for
+	// a kernel change can be reproduced and rerun after later changes. Best of a few repetitions, on the calling thread
+	namespace MicroBenchmarks
+	{
+		// "triangles": the record based triangle test against the indexed plane + edge test it replaced, and closest/any hit
+		// rays through the whole mesh, on a generated terrain of about a million triangles
+		// "shading": ShadeMaterial against ShadeMaterial_Batch for every MaterialType, on one batch of random (n, l, v) tuples
+		// returns false for an unknown name
+		bool Run(const std::string& name);
+
+		void PrintNames();
+	}
+}
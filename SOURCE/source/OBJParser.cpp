@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+
+#include "OBJParser.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	namespace
+	{
+		constexpr size_t minChunkSize{ size_t{ 1 } << 20 };		// smaller files are parsed on the calling thread
+		constexpr uint32_t nrChunksPerWorker{ 4 };				// a few chunks per worker so the pool can balance them
+		constexpr size_t nrTrianglesPerNormalTask{ 1 << 16 };
+
+		struct ChunkResult
+		{
+			std::vector<Vector3> positions{};
+			std::vector<int> indices{};					// 0 based, relative ones are still relative to the chunk's first vertex
+			std::vector<size_t> relativeIndexSlots{};	// where those relative indices are in indices
+			bool isValid{ true };
+		};
+
+		struct FaceVertex
+		{
+			int index;
+			bool isRelative;
+		};
+
+		bool IsSpace(const char character)
+		{
+			return character == ' ' || character == '\t' || character == '\r';
+		}
+
+		const char* SkipSpaces(const char* pCurrent, const char* pEnd)
+		{
+			while (pCurrent < pEnd && IsSpace(*pCurrent)) ++pCurrent;
+			return pCurrent;
+		}
+
+		const char* SkipLine(const char* pCurrent, const char* pEnd)
+		{
+			const char* pLineEnd{ std::find(pCurrent, pEnd, '\n') };
+			return pLineEnd == pEnd ? pEnd : pLineEnd + 1;
+		}
+
+		bool ParseFloat(const char*& pCurrent, const char* pEnd, float& value)
+		{
+			pCurrent = SkipSpaces(pCurrent, pEnd);
+			if (pCurrent < pEnd && *pCurrent == '+') ++pCurrent;	// from_chars doesn't take a leading '+'
+
+			const std::from_chars_result result{ std::from_chars(pCurrent, pEnd, value) };
+			if (result.ec != std::errc{}) return false;
+
+			pCurrent = result.ptr;
+			return true;
+		}
+
+		bool ParseInt(const char*& pCurrent, const char* pEnd, int& value)
+		{
+			if (pCurrent < pEnd && *pCurrent == '+') ++pCurrent;
+
+			const std::from_chars_result result{ std::from_chars(pCurrent, pEnd, value) };
+			if (result.ec != std::errc{}) return false;
+
+			pCurrent = result.ptr;
+			return true;
+		}
+
+		// One face vertex (v, v/vt, v//vn or v/vt/vn), only the position index is kept
+		bool ParseFaceVertex(const char*& pCurrent, const char* pEnd, int& positionIdx)
+		{
+			if (!ParseInt(pCurrent, pEnd, positionIdx) || positionIdx == 0) return false;
+
+			for (int nrSlashes{}; nrSlashes < 2 && pCurrent < pEnd && *pCurrent == '/'; ++nrSlashes)
+			{
+				++pCurrent;
+
+				// vt can be left out (v//vn)
+				int ignoredIdx{};
+				if (pCurrent < pEnd && *pCurrent != '/') ParseInt(pCurrent, pEnd, ignoredIdx);
+			}
+			return true;
+		}
+
+		void ParseFace(const char* pCurrent, const char* pEnd, ChunkResult& chunk, std::vector<FaceVertex>& faceVertices)
+		{
+			faceVertices.clear();
+
+			while (true)
+			{
+				pCurrent = SkipSpaces(pCurrent, pEnd);
+				if (pCurrent >= pEnd || *pCurrent == '\n' || *pCurrent == '#') break;
+
+				int positionIdx{};
+				if (!ParseFaceVertex(pCurrent, pEnd, positionIdx))
+				{
+					chunk.isValid = false;
+					return;
+				}
+
+				// negative indices count back from the last vertex read so far (can point into an earlier chunk)
+				if (positionIdx > 0) faceVertices.emplace_back(FaceVertex{ positionIdx - 1, false });
+				else faceVertices.emplace_back(FaceVertex{ static_cast<int>(chunk.positions.size()) + positionIdx, true });
+			}
+
+			if (faceVertices.size() < 3)
+			{
+				chunk.isValid = false;
+				return;
+			}
+
+			const auto storeIndex = [&chunk](const FaceVertex& faceVertex)
+			{
+				if (faceVertex.isRelative) chunk.relativeIndexSlots.emplace_back(chunk.indices.size());
+				chunk.indices.emplace_back(faceVertex.index);
+			};
+
+			// fan triangulation, a triangle gives exactly one triangle
+			for (size_t cornerIdx{ 1 }; cornerIdx + 1 < faceVertices.size(); ++cornerIdx)
+			{
+				storeIndex(faceVertices[0]);
+				storeIndex(faceVertices[cornerIdx]);
+				storeIndex(faceVertices[cornerIdx + 1]);
+			}
+		}
+
+		void ParseChunk(const char* pCurrent, const char* pEnd, ChunkResult& chunk)
+		{
+			std::vector<FaceVertex> faceVertices{};
+
+			while (pCurrent < pEnd && chunk.isValid)
+			{
+				pCurrent = SkipSpaces(pCurrent, pEnd);
+				if (pEnd - pCurrent < 2)
+				{
+					pCurrent = SkipLine(pCurrent, pEnd);
+					continue;
+				}
+
+				const bool isCommand{ IsSpace(pCurrent[1]) };
+
+				if (isCommand && pCurrent[0] == 'v')
+				{
+					//Vertex
+					const char* pValues{ pCurrent + 1 };
+					Vector3 position{};
+					if (!ParseFloat(pValues, pEnd, position.x) || !ParseFloat(pValues, pEnd, position.y) || !ParseFloat(pValues, pEnd, position.z))
+					{
+						chunk.isValid = false;
+						break;
+					}
+					chunk.positions.emplace_back(position);
+				}
+				else if (isCommand && pCurrent[0] == 'f')
+				{
+					ParseFace(pCurrent + 1, pEnd, chunk, faceVertices);
+				}
+				// comments, vt, vn, o, g, s, usemtl, ... are skipped
+
+				pCurrent = SkipLine(pCurrent, pEnd);
+			}
+		}
+
+		void CalculateFaceNormals(const Vector3* pPositions, const int* pIndices, Vector3* pNormals, const size_t firstTriangle, const size_t lastTriangle)
+		{
+			for (size_t triangleIdx{ firstTriangle }; triangleIdx < lastTriangle; ++triangleIdx)
+			{
+				const Vector3& V0{ pPositions[pIndices[triangleIdx * 3]] };
+				const Vector3& V1{ pPositions[pIndices[triangleIdx * 3 + 1]] };
+				const Vector3& V2{ pPositions[pIndices[triangleIdx * 3 + 2]] };
+
+				Vector3 normal{ Vector3::Cross(V1 - V0, V2 - V0) };
+				normal.Normalize();
+				pNormals[triangleIdx] = normal;
+			}
+		}
+	}
+
+	namespace Utils
+	{
+		bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices,
+			ThreadPool* pThreadPool)
+		{
+			const MappedFile file{ filename };
+			if (!file.IsOpen()) return false;
+
+			const char* pBegin{ file.GetData() };
+			const char* pEnd{ pBegin + file.GetSize() };
+
+			ThreadPool* pOwnThreadPool{ nullptr };
+			uint32_t nrChunks{ 1 };
+			if (file.GetSize() < 2 * minChunkSize)
+			{
+				pThreadPool = nullptr;
+			}
+			else
+			{
+				if (!pThreadPool)
+				{
+					pOwnThreadPool = new ThreadPool{};
+					pThreadPool = pOwnThreadPool;
+				}
+				const size_t maxNrChunks{ size_t{ pThreadPool->GetNrOfWorkers() } * nrChunksPerWorker };
+				nrChunks = static_cast<uint32_t>(std::min(file.GetSize() / minChunkSize, maxNrChunks));
+			}
+
+			// chunk borders are moved to the next line start so no line is split
+			std::vector<const char*> chunkBorders(nrChunks + 1);
+			chunkBorders[0] = pBegin;
+			chunkBorders[nrChunks] = pEnd;
+			for (uint32_t chunkIdx{ 1 }; chunkIdx < nrChunks; ++chunkIdx)
+			{
+				const char* pSplit{ pBegin + file.GetSize() / nrChunks * chunkIdx };
+				chunkBorders[chunkIdx] = std::max(chunkBorders[chunkIdx - 1], SkipLine(pSplit, pEnd));
+			}
+
+			std::vector<ChunkResult> chunks(nrChunks);
+			const auto parseChunk = [&](uint32_t chunkIdx)
+			{
+				ParseChunk(chunkBorders[chunkIdx], chunkBorders[chunkIdx + 1], chunks[chunkIdx]);
+			};
+
+			if (pThreadPool) pThreadPool->ParallelFor(nrChunks, parseChunk);
+			else parseChunk(0);
+
+			// merge, the vertex indices in the file are global so only the relative ones need an offset
+			size_t nrPositions{};
+			size_t nrIndices{};
+			bool isValid{ true };
+			for (const ChunkResult& chunk : chunks)
+			{
+				nrPositions += chunk.positions.size();
+				nrIndices += chunk.indices.size();
+				isValid = isValid && chunk.isValid;
+			}
+
+			if (isValid)
+			{
+				const size_t firstIndex{ indices.size() };
+				positions.reserve(positions.size() + nrPositions);
+				indices.reserve(indices.size() + nrIndices);
+
+				int chunkFirstVertex{};
+				for (ChunkResult& chunk : chunks)
+				{
+					for (const size_t slot : chunk.relativeIndexSlots)
+					{
+						chunk.indices[slot] += chunkFirstVertex;
+					}
+
+					positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+					indices.insert(indices.end(), chunk.indices.begin(), chunk.indices.end());
+					chunkFirstVertex += static_cast<int>(chunk.positions.size());
+				}
+
+				const int nrFilePositions{ static_cast<int>(nrPositions) };
+				isValid = std::all_of(indices.begin() + firstIndex, indices.end(), [nrFilePositions](const int index)
+				{
+					return index >= 0 && index < nrFilePositions;
+				});
+
+				if (isValid)
+				{
+					//Precompute normals
+					const size_t firstTriangle{ normals.size() };
+					const size_t nrTriangles{ nrIndices / 3 };
+					normals.resize(firstTriangle + nrTriangles);
+
+					// the triangles of this file only (the indices are relative to the file's own vertices)
+					const Vector3* pFilePositions{ positions.data() + (positions.size() - nrPositions) };
+					const int* pFileIndices{ indices.data() + firstIndex };
+					Vector3* pFileNormals{ normals.data() + firstTriangle };
+
+					const uint32_t nrTasks{ static_cast<uint32_t>((nrTriangles + nrTrianglesPerNormalTask - 1) / nrTrianglesPerNormalTask) };
+					const auto calculateNormals = [&](uint32_t taskIdx)
+					{
+						const size_t first{ taskIdx * nrTrianglesPerNormalTask };
+						CalculateFaceNormals(pFilePositions, pFileIndices, pFileNormals, first, std::min(first + nrTrianglesPerNormalTask, nrTriangles));
+					};
+
+					if (pThreadPool && nrTasks > 1) pThreadPool->ParallelFor(nrTasks, calculateNormals);
+					else if (nrTasks > 0) CalculateFaceNormals(pFilePositions, pFileIndices, pFileNormals, 0, nrTriangles);
+				}
+			}
+
+			delete pOwnThreadPool;
+			return isValid;
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	class ThreadPool;
+
+	namespace Utils
+	{
+		// Parses the positions and faces of an OBJ file, results are appended to the vectors
+		// The file is memory mapped, big files are split in chunks (on line ends) that are parsed in parallel
+		// Faces accept every index form (v, v/vt, v//vn, v/vt/vn, negative = relative) and polygons are triangulated as a fan
+		// normals gets one face normal per triangle (what TriangleMesh uses), texture coordinates and vertex normals are skipped
+		// Big files use pThreadPool, or a pool of their own when there is none
+		bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices,
+			ThreadPool* pThreadPool = nullptr);
+	}
+}
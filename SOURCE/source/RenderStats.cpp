@@ -0,0 +1,83 @@
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <mutex>
+
+namespace dae
+{
+	namespace
+	{
+		// deque: the threads keep pointers to their counters, those may not move when others register
+		std::mutex g_RegistryMutex{};
+		std::deque<RenderCounters> g_ThreadCounters{};
+	}
+
+	RenderCounters& RenderCounters::operator+=(const RenderCounters& other)
+	{
+		primaryRays += other.primaryRays;
+		shadowRays += other.shadowRays;
+		boxTests += other.boxTests;
+		triangleTests += other.triangleTests;
+		nodesVisited += other.nodesVisited;
+
+		rayGenerationTime += other.rayGenerationTime;
+		traversalTime += other.traversalTime;
+		shadingTime += other.shadingTime;
+		presentationTime += other.presentationTime;
+
+		return *this;
+	}
+
+	FrameStats& FrameStats::operator+=(const FrameStats& other)
+	{
+		counters += other.counters;
+		frameTime += other.frameTime;
+		nrOfFrames += other.nrOfFrames;
+
+		return *this;
+	}
+
+	double FrameStats::GetMRaysPerSecond() const
+	{
+		if (frameTime <= 0.0) return 0.0;
+		return counters.GetNrOfRays() / frameTime / 1'000'000.0;
+	}
+
+	void FrameStats::Print() const
+	{
+		const double nrOfRays{ static_cast<double>(std::max<uint64_t>(counters.GetNrOfRays(), 1)) };
+		const double stageTime{ counters.rayGenerationTime + counters.traversalTime + counters.shadingTime + counters.presentationTime };
+		const double toPercentage{ stageTime > 0.0 ? 100.0 / stageTime : 0.0 };
+
+		std::cout << GetMRaysPerSecond() << " Mrays/s"
+			<< " (" << counters.primaryRays << " primary, " << counters.shadowRays << " shadow rays in " << nrOfFrames << " frame(s))"
+			<< " | per ray: " << counters.nodesVisited / nrOfRays << " nodes, " << counters.boxTests / nrOfRays << " boxes, "
+			<< counters.triangleTests / nrOfRays << " triangles"
+			<< " | camera rays " << counters.rayGenerationTime * toPercentage << "%, traversal " << counters.traversalTime * toPercentage
+			<< "%, shading " << counters.shadingTime * toPercentage << "%, presentation " << counters.presentationTime * toPercentage << "%\n";
+	}
+
+	namespace RenderStats
+	{
+		RenderCounters* RegisterThread()
+		{
+			const std::lock_guard lock{ g_RegistryMutex };
+			return &g_ThreadCounters.emplace_back();
+		}
+
+		RenderCounters CollectCounters()
+		{
+			const std::lock_guard lock{ g_RegistryMutex };
+
+			RenderCounters total{};
+			for (RenderCounters& counters : g_ThreadCounters)
+			{
+				total += counters;
+				counters = {};
+			}
+			return total;
+		}
+	}
+}
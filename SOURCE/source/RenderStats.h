@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	// What the render threads counted, every thread fills its own copy (RenderStats::GetThreadCounters),
+	// the renderer merges them once the frame is done
+	struct RenderCounters
+	{
+		uint64_t primaryRays{};
+		uint64_t shadowRays{};
+		uint64_t boxTests{};		// ray/box slab tests, a 4 ray packet against one box counts once
+		uint64_t triangleTests{};
+		uint64_t nodesVisited{};	// inner hierarchy nodes whose children got tested (top level + mesh)
+
+		// seconds, summed over the threads (so a share of the thread time, not of the frame time)
+		double rayGenerationTime{};	// camera rays
+		double traversalTime{};		// primary rays
+		double shadingTime{};		// light loop, shadow rays included
+		double presentationTime{};	// accumulation, pixel writes and presenting the window surface
+
+		RenderCounters& operator+=(const RenderCounters& other);
+
+		uint64_t GetNrOfRays() const { return primaryRays + shadowRays; }
+	};
+
+	// Counters of one or more frames, see Renderer::GetFrameStats
+	struct FrameStats
+	{
+		RenderCounters counters{};
+		double frameTime{};			// seconds, wall clock of Renderer::Render
+		uint32_t nrOfFrames{};
+
+		FrameStats& operator+=(const FrameStats& other);
+
+		double GetMRaysPerSecond() const;
+
+		// one line for the console: Mrays/s, rays, tests per ray and the stage split
+		void Print() const;
+	};
+
+	namespace RenderStats
+	{
+		RenderCounters* RegisterThread();
+
+		// nullptr until the thread counts its first ray, see GetThreadCounters
+		inline thread_local RenderCounters* t_pThreadCounters{ nullptr };
+
+		// Counters of the calling thread, lives as long as the program (threads that are gone still count)
+		inline RenderCounters& GetThreadCounters()
+		{
+			if (!t_pThreadCounters) t_pThreadCounters = RegisterThread();
+			return *t_pThreadCounters;
+		}
+
+		// Sum of every thread's counters since the last collect, resets them
+		// Only call this while no thread is rendering (between frames)
+		RenderCounters CollectCounters();
+	}
+}
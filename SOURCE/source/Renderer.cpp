@@ -1,6 +1,8 @@
 //External includes
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <iostream>
-#include <execution>
 #include "SDL.h"
 #include "SDL_surface.h"
 
@@ -10,147 +12,513 @@
 #include "Matrix.h"
 #include "Material.h"
 #include "Scene.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
 #define PARALLEL_EXECUTION
+#define PACKET_TRACING
 
 using namespace dae;
 
+// Filled by RenderTile, hit samples keep the tile's trace order, sortedSamples holds them grouped per material
+struct Renderer::TileSamples
+{
+	std::vector<uint32_t> pixelIndices{};
+	std::vector<Vector3> viewDirections{};
+	std::vector<HitRecord> hits{};
+	std::vector<ColorRGB> colors{};
+
+	// samples of material m are sortedSamples[materialOffsets[m] .. materialOffsets[m + 1]), misses are left out
+	std::vector<uint32_t> sortedSamples{};
+	std::vector<uint32_t> materialOffsets{};
+
+	// batch currently being filled, per lane the sample it belongs to and its light terms
+	BRDF::ShadingBatch batch{};
+	BRDF::ColorBatch batchColors{};
+	uint32_t batchSamples[BRDF::shadingBatchSize]{};
+	float batchObservedAreas[BRDF::shadingBatchSize]{};
+	ColorRGB batchRadiances[BRDF::shadingBatchSize]{};
+
+	void Clear()
+	{
+		pixelIndices.clear();
+		viewDirections.clear();
+		hits.clear();
+		colors.clear();
+	}
+
+	// the hit gets traced later (Renderer::TraceSample/TraceQuad)
+	void Add(const uint32_t pixelIndex, const Vector3& viewDirection)
+	{
+		pixelIndices.emplace_back(pixelIndex);
+		viewDirections.emplace_back(viewDirection);
+		hits.emplace_back();
+		colors.emplace_back();
+	}
+
+	// every hit in one group, for the lighting modes that don't evaluate the BRDF
+	void GroupHits()
+	{
+		sortedSamples.clear();
+		for (uint32_t sampleIdx{}; sampleIdx < hits.size(); ++sampleIdx)
+		{
+			if (hits[sampleIdx].didHit) sortedSamples.emplace_back(sampleIdx);
+		}
+
+		materialOffsets.assign({ 0, static_cast<uint32_t>(sortedSamples.size()) });
+	}
+
+	// counting sort on the material index
+	void GroupByMaterial(const uint32_t nrMaterials)
+	{
+		materialOffsets.assign(nrMaterials + 1, 0);
+		for (const HitRecord& hit : hits)
+		{
+			if (!hit.didHit) continue;
+			assert(hit.materialIndex < nrMaterials && "Hit has no material in the scene's table");
+			++materialOffsets[hit.materialIndex + 1];
+		}
+
+		for (uint32_t materialIdx{}; materialIdx < nrMaterials; ++materialIdx)
+		{
+			materialOffsets[materialIdx + 1] += materialOffsets[materialIdx];
+		}
+
+		sortedSamples.resize(materialOffsets[nrMaterials]);
+
+		// insert positions, restored to the group starts afterwards
+		for (uint32_t sampleIdx{}; sampleIdx < hits.size(); ++sampleIdx)
+		{
+			if (hits[sampleIdx].didHit) sortedSamples[materialOffsets[hits[sampleIdx].materialIndex]++] = sampleIdx;
+		}
+
+		for (uint32_t materialIdx{ nrMaterials }; materialIdx > 0; --materialIdx)
+		{
+			materialOffsets[materialIdx] = materialOffsets[materialIdx - 1];
+		}
+		materialOffsets[0] = 0;
+	}
+};
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double GetSeconds(const Clock::time_point start, const Clock::time_point end)
+	{
+		return std::chrono::duration<double>(end - start).count();
+	}
+
+	// Jitter inside the pixel for progressive samples, sample 0 is always the pixel centre
+	void GetSampleOffset(const uint32_t pixelIndex, const uint32_t sampleIndex, float& offsetX, float& offsetY)
+	{
+		if (sampleIndex == 0)
+		{
+			offsetX = 0.5f;
+			offsetY = 0.5f;
+			return;
+		}
+
+		// PCG style integer hash, cheap and stateless so every thread can use it
+		uint32_t state{ pixelIndex * 747796405u + sampleIndex * 2891336453u };
+		const auto nextRandom = [&state]()
+		{
+			state = state * 747796405u + 2891336453u;
+			uint32_t word{ ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u };
+			word = (word >> 22u) ^ word;
+			return (word >> 8) * (1.f / 16777216.f);
+		};
+
+		offsetX = nextRandom();
+		offsetY = nextRandom();
+	}
+}
+
 Renderer::Renderer(SDL_Window* pWindow, const int width, const int height)
+	: Renderer{ pWindow, SDL_GetWindowSurface(pWindow), width, height }
+{
+}
+
+Renderer::Renderer(const int width, const int height)
+	: Renderer{ nullptr, SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888), width, height }
+{
+	m_OwnsBuffer = true;
+}
+
+Renderer::Renderer(SDL_Window* pWindow, SDL_Surface* pBuffer, const int width, const int height)
 	: m_pWindow{ pWindow },
-	m_pBuffer{ SDL_GetWindowSurface(pWindow) },
+	m_pBuffer{ pBuffer },
 	m_Width{ width },
 	m_Height{ height },
 	m_NrOfPixels{ static_cast<uint32_t>(width * height) },
 	m_AspectRatio{ float(m_Width) / m_Height }
 {
 	//Initialize
+	assert(m_pBuffer && "Renderer has no surface to render to");
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 
-	m_PixelIndices.resize(m_NrOfPixels);
-	for (uint32_t pixelIdx{}; pixelIdx < m_NrOfPixels; ++pixelIdx)
-	{
-		m_PixelIndices[pixelIdx] = pixelIdx;
-	}
+	m_AccumulationBuffer.resize(m_NrOfPixels);
+
+	m_pThreadPool = new ThreadPool{};
+}
+
+Renderer::~Renderer()
+{
+	delete m_pThreadPool;
+
+	if (m_OwnsBuffer) SDL_FreeSurface(m_pBuffer);
 }
 
-void Renderer::Render(Scene* pScene) const
+void Renderer::Render(Scene* pScene)
 {
+	const Clock::time_point frameStartTime{ Clock::now() };
+
 	// ................................................................................................................;
+	// objects might have moved during the scene update
+	pScene->UpdateTopLevelBVH(m_pThreadPool);
+
 	Camera& camera{ pScene->GetCamera() };
-	const std::vector< dae::Material* >& materials{ pScene->GetMaterials() };
+	const std::vector< dae::MaterialData >& materials{ pScene->GetMaterialTable() };
 	const std::vector< dae::Light >& lights{ pScene->GetLights() };
 
 	const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
 
+	// the toggles only change between frames
+	const ShadeTileKernel shadeTile{ GetShadeTileKernel() };
+
+	// Progressive accumulation: keep adding samples while nothing changed
+	if (!m_AccumulationEnabled
+		|| pScene != m_pAccumulatedScene
+		|| pScene->GetVersion() != m_AccumulatedSceneVersion
+		|| cameraToWorld != m_AccumulatedCameraToWorld
+		|| camera.fovValue != m_AccumulatedFov)
+	{
+		ResetAccumulation();
+		m_pAccumulatedScene = pScene;
+		m_AccumulatedSceneVersion = pScene->GetVersion();
+		m_AccumulatedCameraToWorld = cameraToWorld;
+		m_AccumulatedFov = camera.fovValue;
+	}
+
 #ifdef PARALLEL_EXECUTION
 	// Parallel logic //
-	std::for_each(std::execution::par, m_PixelIndices.begin(), m_PixelIndices.end(), [&](int i)
+	const uint32_t nrTilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+	const uint32_t nrTilesY{ (m_Height + m_TileSize - 1) / m_TileSize };
+
+	m_pThreadPool->ParallelFor(nrTilesX * nrTilesY, [&](uint32_t tileIdx)
 	{
-		RenderPixel(pScene, materials, lights, i, camera.fovValue, cameraToWorld, camera.origin);
+		const uint32_t startX{ (tileIdx % nrTilesX) * m_TileSize };
+		const uint32_t startY{ (tileIdx / nrTilesX) * m_TileSize };
+		const uint32_t endX{ std::min(startX + m_TileSize, static_cast<uint32_t>(m_Width)) };
+		const uint32_t endY{ std::min(startY + m_TileSize, static_cast<uint32_t>(m_Height)) };
+
+		RenderTile(pScene, materials, lights, shadeTile, startX, startY, endX, endY, camera.fovValue, cameraToWorld, camera.origin);
 	});
 
 #else 
 	// Synchornous logic (no threading) //
-	for (uint32_t pixelIdx{}; pixelIdx < m_NrOfPixels; ++pixelIdx)
-	{
-		RenderPixel(pScene, materials, lights, pixelIdx, camera.fovValue, cameraToWorld, camera.origin);
-	}
+	RenderTile(pScene, materials, lights, shadeTile, 0, 0, m_Width, m_Height, camera.fovValue, cameraToWorld, camera.origin);
 
 #endif
 	// ................................................................................................................;
 
+	++m_NrOfSamples;
+
 	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	//Update SDL Surface (headless: nothing to present)
+	if (m_pWindow)
+	{
+		const Clock::time_point presentStartTime{ Clock::now() };
+		SDL_UpdateWindowSurface(m_pWindow);
+		RenderStats::GetThreadCounters().presentationTime += GetSeconds(presentStartTime, Clock::now());
+	}
+
+	// the workers are idle again, their counters can be merged
+	m_FrameStats.counters = RenderStats::CollectCounters();
+	m_FrameStats.frameTime = GetSeconds(frameStartTime, Clock::now());
+	m_FrameStats.nrOfFrames = 1;
 }
 
-void dae::Renderer::RenderPixel(
-	Scene* pScene, 
-	const std::vector< dae::Material* >& materials,
+void dae::Renderer::RenderTile(
+	Scene* pScene,
+	const std::vector< dae::MaterialData >& materials,
 	const std::vector< dae::Light >& lights,
-	const uint32_t pixelIndex, 
+	const ShadeTileKernel shadeTile,
+	const uint32_t startX, const uint32_t startY, const uint32_t endX, const uint32_t endY,
 	const float fov,
-	const Matrix& cameraToWorld, 
-	const Vector3& cameraOrigin) const
+	const Matrix& cameraToWorld,
+	const Vector3& cameraOrigin)
 {
-	constexpr int colorCorrector{ 255 };
-	constexpr float offset{ 0.00001f };
+	// one per worker, keeps its capacity between tiles
+	thread_local TileSamples samples;
+	samples.Clear();
+
+	const Clock::time_point startTime{ Clock::now() };
+
+	// CAMERA RAYS //
+	const auto addSample = [&](const uint32_t px, const uint32_t py)
+	{
+		const uint32_t pixelIndex{ px + py * m_Width };
+		samples.Add(pixelIndex, CalculateViewDirection(pixelIndex, fov, cameraToWorld));
+	};
+
+#ifdef PACKET_TRACING
+	// 2x2 quads first, traced as packets
+	const uint32_t quadEndX{ startX + ((endX - startX) & ~1u) };
+	const uint32_t quadEndY{ startY + ((endY - startY) & ~1u) };
+	for (uint32_t py{ startY }; py < quadEndY; py += 2)
+	{
+		for (uint32_t px{ startX }; px < quadEndX; px += 2)
+		{
+			addSample(px, py);
+			addSample(px + 1, py);
+			addSample(px, py + 1);
+			addSample(px + 1, py + 1);
+		}
+	}
+#else
+	const uint32_t quadEndX{ startX };
+	const uint32_t quadEndY{ startY };
+#endif
+	const uint32_t nrQuadSamples{ static_cast<uint32_t>(samples.pixelIndices.size()) };
+
+	// odd tile edges as single rays
+	for (uint32_t py{ startY }; py < endY; ++py)
+	{
+		for (uint32_t px{ startX }; px < endX; ++px)
+		{
+			if (px < quadEndX && py < quadEndY) continue;
+			addSample(px, py);
+		}
+	}
+
+	const uint32_t nrSamples{ static_cast<uint32_t>(samples.pixelIndices.size()) };
+	const Clock::time_point traceStartTime{ Clock::now() };
+
+	// PRIMARY RAYS //
+	for (uint32_t sampleIdx{}; sampleIdx < nrQuadSamples; sampleIdx += rayPacketSize)
+	{
+		TraceQuad(pScene, samples, sampleIdx, cameraOrigin);
+	}
+	for (uint32_t sampleIdx{ nrQuadSamples }; sampleIdx < nrSamples; ++sampleIdx)
+	{
+		TraceSample(pScene, samples, sampleIdx, cameraOrigin);
+	}
+
+	const Clock::time_point shadeStartTime{ Clock::now() };
 
+	// SHADING //
+	(this->*shadeTile)(pScene, materials, lights, samples);
+
+	const Clock::time_point writeStartTime{ Clock::now() };
+
+	for (uint32_t sampleIdx{}; sampleIdx < nrSamples; ++sampleIdx)
+	{
+		WritePixel(samples.pixelIndices[sampleIdx], samples.colors[sampleIdx]);
+	}
+
+	RenderCounters& counters{ RenderStats::GetThreadCounters() };
+	counters.primaryRays += nrSamples;
+	counters.rayGenerationTime += GetSeconds(startTime, traceStartTime);
+	counters.traversalTime += GetSeconds(traceStartTime, shadeStartTime);
+	counters.shadingTime += GetSeconds(shadeStartTime, writeStartTime);
+	counters.presentationTime += GetSeconds(writeStartTime, Clock::now());
+}
+
+void dae::Renderer::TraceSample(Scene* pScene, TileSamples& samples, const uint32_t sampleIdx, const Vector3& cameraOrigin) const
+{
+	Ray vieuwRay{ cameraOrigin, -samples.viewDirections[sampleIdx] };
+	pScene->GetClosestHit(vieuwRay, samples.hits[sampleIdx]);
+}
+
+void dae::Renderer::TraceQuad(Scene* pScene, TileSamples& samples, const uint32_t firstSampleIdx, const Vector3& cameraOrigin) const
+{
+	RayPacket vieuwPacket;
+	for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+	{
+		vieuwPacket.rays[lane] = Ray{ cameraOrigin, -samples.viewDirections[firstSampleIdx + lane] };
+	}
+
+	HitRecord closestHits[rayPacketSize];
+	pScene->GetClosestHits(vieuwPacket, closestHits);
+
+	std::copy(std::begin(closestHits), std::end(closestHits), samples.hits.begin() + firstSampleIdx);
+}
+
+Vector3 dae::Renderer::CalculateViewDirection(const uint32_t pixelIndex, const float fov, const Matrix& cameraToWorld) const
+{
 	const uint32_t px{ pixelIndex % m_Width };
 	const uint32_t py{ pixelIndex / m_Width };
 
-	const float rx{ px + 0.5f };
-	const float ry{ py + 0.5f };
+	float sampleOffsetX;
+	float sampleOffsetY;
+	GetSampleOffset(pixelIndex, m_NrOfSamples, sampleOffsetX, sampleOffsetY);
+
+	const float rx{ px + sampleOffsetX };
+	const float ry{ py + sampleOffsetY };
 
 	const float pxC{ ((rx / m_Width * 2.f) - 1.f) * m_AspectRatio * fov };
 	const float pyC{ (1.f - ry / m_Height * 2.f) * fov };
 
-	ColorRGB finalColor;
+	// points from the pixel towards the camera (view vector for the BRDFs), the view ray uses the negation
+	return -cameraToWorld.TransformVector(pxC, pyC, 1.f).Normalized();
+}
 
-	HitRecord closestHit;
+Renderer::ShadeTileKernel Renderer::GetShadeTileKernel() const
+{
+	// [lighting mode][shadows enabled]
+	static constexpr ShadeTileKernel shadeTileKernels[][2]
+	{
+		{ &Renderer::ShadeTile<LightingMode::ObserverdArea, false>, &Renderer::ShadeTile<LightingMode::ObserverdArea, true> },
+		{ &Renderer::ShadeTile<LightingMode::Radiance, false>, &Renderer::ShadeTile<LightingMode::Radiance, true> },
+		{ &Renderer::ShadeTile<LightingMode::BRDF, false>, &Renderer::ShadeTile<LightingMode::BRDF, true> },
+		{ &Renderer::ShadeTile<LightingMode::Combined, false>, &Renderer::ShadeTile<LightingMode::Combined, true> }
+	};
 
-	Vector3 rayDirection{ -cameraToWorld.TransformVector(pxC, pyC, 1.f).Normalized() };
+	return shadeTileKernels[static_cast<int>(m_CurrentLightMode)][m_ShadowEnabled ? 1 : 0];
+}
 
-	Ray vieuwRay{ cameraOrigin, -rayDirection };
+template<Renderer::LightingMode lightingMode, bool shadowsEnabled>
+void dae::Renderer::ShadeTile(
+	Scene* pScene,
+	const std::vector< dae::MaterialData >& materials,
+	const std::vector< dae::Light >& lights,
+	TileSamples& samples) const
+{
+	constexpr float offset{ 0.00001f };
+
+	constexpr bool usesBRDF{ lightingMode == LightingMode::BRDF || lightingMode == LightingMode::Combined };
+	constexpr bool usesRadiance{ lightingMode == LightingMode::Radiance || lightingMode == LightingMode::Combined };
+
+	// only the BRDF cares about the material
+	if constexpr (usesBRDF) samples.GroupByMaterial(static_cast<uint32_t>(materials.size()));
+	else samples.GroupHits();
+
+	const uint32_t nrGroups{ static_cast<uint32_t>(samples.materialOffsets.size() - 1) };
 
-	if (pScene->GetClosestHit(vieuwRay, closestHit))
+	BRDF::ShadingBatch& batch{ samples.batch };
+	uint64_t nrShadowRays{};
+
+	// lights stay the outer loop so every pixel sums its lights in the same order as before
+	for (const Light& light : lights)
 	{
-		for (const Light& light : lights)
+		for (uint32_t groupIdx{}; groupIdx < nrGroups; ++groupIdx)
 		{
-			Vector3 lightDirection{ LightUtils::GetDirectionToLight(light, closestHit.origin) };
+			batch.count = 0;
 
-			const float maxLightRay{ lightDirection.Normalize() };
+			for (uint32_t sortedIdx{ samples.materialOffsets[groupIdx] }; sortedIdx < samples.materialOffsets[groupIdx + 1]; ++sortedIdx)
+			{
+				const uint32_t sampleIdx{ samples.sortedSamples[sortedIdx] };
+				const HitRecord& closestHit{ samples.hits[sampleIdx] };
 
-			Ray lightRay{ closestHit.origin + (closestHit.normal * offset), lightDirection };
+				Vector3 lightDirection{ LightUtils::GetDirectionToLight(light, closestHit.origin) };
 
-			lightRay.max = maxLightRay;
+				const float maxLightRay{ lightDirection.Normalize() };
 
-			if (!(m_ShadowEnabled && pScene->DoesHit(lightRay)))
-			{
+				// facing away from the light, no need for a shadow ray
 				const float observedArea{ Vector3::Dot(closestHit.normal, lightDirection) };
-				if (!(observedArea < 0.f))
+				if (observedArea < 0.f) continue;
+
+				if constexpr (shadowsEnabled)
 				{
-					const dae::ColorRGB radiance = LightUtils::GetRadiance(light, closestHit.origin);
-					const dae::ColorRGB BRDFColor{ materials[closestHit.materialIndex]->Shade(closestHit, lightDirection, rayDirection) };
+					Ray lightRay{ closestHit.origin + (closestHit.normal * offset), lightDirection };
 
-					switch (m_CurrentLightMode)
-					{
-					case dae::Renderer::LightingMode::ObserverdArea:
-						finalColor += observedArea;
-						break;
+					lightRay.max = maxLightRay;
 
-					case dae::Renderer::LightingMode::Radiance:
-						finalColor += radiance;
-						break;
+					++nrShadowRays;
+					if (pScene->DoesHit(lightRay)) continue;
+				}
 
-					case dae::Renderer::LightingMode::BRDF:
-						finalColor += BRDFColor;
-						break;
+				if constexpr (lightingMode == LightingMode::ObserverdArea)
+				{
+					samples.colors[sampleIdx] += observedArea;
+				}
+				else if constexpr (lightingMode == LightingMode::Radiance)
+				{
+					samples.colors[sampleIdx] += LightUtils::GetRadiance(light, closestHit.origin);
+				}
+				else
+				{
+					const uint32_t lane{ batch.Add(closestHit.normal, lightDirection, samples.viewDirections[sampleIdx]) };
+					samples.batchSamples[lane] = sampleIdx;
+					if constexpr (usesRadiance)
+					{
+						samples.batchObservedAreas[lane] = observedArea;
+						samples.batchRadiances[lane] = LightUtils::GetRadiance(light, closestHit.origin);
+					}
 
-					case dae::Renderer::LightingMode::Combined:
-						finalColor += radiance * BRDFColor * observedArea;
-						break;
+					if (batch.IsFull())
+					{
+						ShadeBatch<lightingMode>(materials[groupIdx], samples);
+						batch.count = 0;
 					}
 				}
 			}
+
+			if constexpr (usesBRDF)
+			{
+				if (batch.count > 0) ShadeBatch<lightingMode>(materials[groupIdx], samples);
+			}
+		}
+	}
+
+	RenderStats::GetThreadCounters().shadowRays += nrShadowRays;
+}
+
+template<Renderer::LightingMode lightingMode>
+void dae::Renderer::ShadeBatch(const dae::MaterialData& material, TileSamples& samples) const
+{
+	const BRDF::ShadingBatch& batch{ samples.batch };
+	const BRDF::ColorBatch& colors{ samples.batchColors };
+
+	ShadeMaterial_Batch(material, batch, samples.batchColors);
+
+	for (uint32_t lane{}; lane < batch.count; ++lane)
+	{
+		ColorRGB& finalColor{ samples.colors[samples.batchSamples[lane]] };
+
+		if constexpr (lightingMode == LightingMode::Combined)
+		{
+			finalColor += samples.batchRadiances[lane] * colors.Get(lane) * samples.batchObservedAreas[lane];
+		}
+		else
+		{
+			finalColor += colors.Get(lane);
 		}
 	}
+}
+
+void dae::Renderer::WritePixel(const uint32_t pixelIndex, ColorRGB finalColor)
+{
+	constexpr int colorCorrector{ 255 };
 
 	finalColor.MaxToOne();
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
+
+	if (m_AccumulationEnabled)
+	{
+		ColorRGB& accumulatedColor{ m_AccumulationBuffer[pixelIndex] };
+		if (m_NrOfSamples == 0) accumulatedColor = finalColor;
+		else accumulatedColor += finalColor;
+
+		finalColor = accumulatedColor;
+		finalColor /= static_cast<float>(m_NrOfSamples + 1);
+	}
+
+	m_pBufferPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
 		static_cast<uint8_t>(finalColor.r * colorCorrector),
 		static_cast<uint8_t>(finalColor.g * colorCorrector),
 		static_cast<uint8_t>(finalColor.b * colorCorrector));
 }
 
-bool Renderer::SaveBufferToImage() const
+bool Renderer::SaveBufferToImage(const char* filePath) const
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	return SDL_SaveBMP(m_pBuffer, filePath);
 }
 
 void Renderer::CycleLightingMode()
 {
+	ResetAccumulation();
+
 	switch (m_CurrentLightMode)
 	{
 	case dae::Renderer::LightingMode::ObserverdArea:
@@ -175,8 +543,45 @@ void Renderer::CycleLightingMode()
 	}
 }
 
+void Renderer::ToggleAccumulation()
+{
+	m_AccumulationEnabled = !m_AccumulationEnabled;
+	ResetAccumulation();
+
+	if (m_AccumulationEnabled)
+	{
+		std::cout << "Accumulation ON\n";
+		return;
+	}
+	std::cout << "Accumulation OFF\n";
+}
+
+void Renderer::ResetAccumulation()
+{
+	// the first sample of the next frame overwrites the buffer, no need to clear it
+	m_NrOfSamples = 0;
+}
+
+void Renderer::SetTileSize(const uint32_t tileSize)
+{
+	m_TileSize = std::max(tileSize, 1u);
+}
+
+void Renderer::SetNrOfWorkers(const uint32_t nrWorkers)
+{
+	delete m_pThreadPool;
+	m_pThreadPool = new ThreadPool{ nrWorkers };
+}
+
+uint32_t Renderer::GetNrOfWorkers() const
+{
+	return m_pThreadPool->GetNrOfWorkers();
+}
+
 void Renderer::ToggleShadows()
 {
+	ResetAccumulation();
+
 	m_ShadowEnabled = !m_ShadowEnabled;
 
 	if (m_ShadowEnabled)
@@ -1,4 +1,10 @@
 #pragma once
+#include <cstdint>
+#include <vector>
+
+#include "ColorRGB.h"
+#include "Matrix.h"
+#include "RenderStats.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -6,9 +12,9 @@ struct SDL_Surface;
 namespace dae
 {
 	class Scene;
-	class Material;
+	struct MaterialData;
+	class ThreadPool;
 
-	struct Matrix;
 	struct Vector3;
 	struct Light;
 
@@ -16,36 +22,45 @@ namespace dae
 	{
 	public:
 		Renderer(SDL_Window* pWindow, const int width, const int height);
-		~Renderer() = default;
+		// Headless: renders into an offscreen surface owned by the renderer, no window (or display) needed
+		Renderer(const int width, const int height);
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
-
-		void RenderPixel(
-			Scene* pScene,
-			const std::vector< dae::Material* >& materials,
-			const std::vector< dae::Light >& lights,
-			const uint32_t pixelIndex,
-			const float fov,
-			const Matrix& cameraToWorld,
-			const Vector3& cameraOrigin) const;
+		void Render(Scene* pScene);
 
-		bool SaveBufferToImage() const;
+		// returns true on failure (SDL_SaveBMP convention)
+		bool SaveBufferToImage(const char* filePath = "RayTracing_Buffer.bmp") const;
 
 		void CycleLightingMode();
 		void ToggleShadows();
+		void ToggleAccumulation();
+
+		// Settings //
+		void SetTileSize(const uint32_t tileSize);
+		void SetNrOfWorkers(const uint32_t nrWorkers); // 0 = one per hardware thread
+		uint32_t GetTileSize() const { return m_TileSize; }
+		uint32_t GetNrOfWorkers() const;
+
+		// Counters and stage timings of the last rendered frame
+		const FrameStats& GetFrameStats() const { return m_FrameStats; }
+
+		// The render workers, free to use for other work (scene loading) while no frame is being rendered
+		ThreadPool* GetThreadPool() const { return m_pThreadPool; }
 
 	private:
+		Renderer(SDL_Window* pWindow, SDL_Surface* pBuffer, const int width, const int height);
 
 		// defaults //
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		bool m_OwnsBuffer{ false };
 
 		const int m_Width;
 		const int m_Height;
@@ -63,9 +78,67 @@ namespace dae
 		};
 		LightingMode m_CurrentLightMode{ LightingMode::Combined };
 
-		// multithreading
-		std::vector<uint32_t> m_PixelIndices{};
+		// Progressive accumulation (static camera + scene) //
+		bool m_AccumulationEnabled{ true };
+		std::vector<ColorRGB> m_AccumulationBuffer{};
+		uint32_t m_NrOfSamples{};
+
+		const Scene* m_pAccumulatedScene{};
+		uint32_t m_AccumulatedSceneVersion{};
+		Matrix m_AccumulatedCameraToWorld{};
+		float m_AccumulatedFov{};
+
+		void ResetAccumulation();
+
+		// Primary hits of a tile, traced first and shaded afterwards (Renderer.cpp)
+		struct TileSamples;
+
+		// ShadeTile instantiated for one (lighting mode, shadows) pair, picked once per frame by GetShadeTileKernel
+		using ShadeTileKernel = void (Renderer::*)(
+			Scene* pScene,
+			const std::vector< dae::MaterialData >& materials,
+			const std::vector< dae::Light >& lights,
+			TileSamples& samples) const;
+
+		ShadeTileKernel GetShadeTileKernel() const;
+
+		void RenderTile(
+			Scene* pScene,
+			const std::vector< dae::MaterialData >& materials,
+			const std::vector< dae::Light >& lights,
+			const ShadeTileKernel shadeTile,
+			const uint32_t startX, const uint32_t startY, const uint32_t endX, const uint32_t endY,
+			const float fov,
+			const Matrix& cameraToWorld,
+			const Vector3& cameraOrigin);
+
+		void TraceSample(Scene* pScene, TileSamples& samples, const uint32_t sampleIdx, const Vector3& cameraOrigin) const;
+
+		// 4 samples starting at firstSampleIdx (a 2x2 pixel quad), primary rays traced as one packet
+		void TraceQuad(Scene* pScene, TileSamples& samples, const uint32_t firstSampleIdx, const Vector3& cameraOrigin) const;
+
+		Vector3 CalculateViewDirection(const uint32_t pixelIndex, const float fov, const Matrix& cameraToWorld) const;
+
+		// Light loop over all samples of the tile, the lit hits of one material are shaded together by the batch BRDFs
+		// Only computes what lightingMode shows, shadow rays are only traced with shadowsEnabled
+		template<LightingMode lightingMode, bool shadowsEnabled>
+		void ShadeTile(
+			Scene* pScene,
+			const std::vector< dae::MaterialData >& materials,
+			const std::vector< dae::Light >& lights,
+			TileSamples& samples) const;
+
+		template<LightingMode lightingMode>
+		void ShadeBatch(const dae::MaterialData& material, TileSamples& samples) const;
+
+		void WritePixel(const uint32_t pixelIndex, ColorRGB finalColor);
+
+		// multithreading (frame is split in square tiles, the pool balances them over the workers)
+		ThreadPool* m_pThreadPool{};
+		uint32_t m_TileSize{ 32 };
 		const uint32_t m_NrOfPixels;
 		int m_ShadowFrame{};
+
+		FrameStats m_FrameStats{};
 	};
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -8,16 +9,24 @@
 
 namespace dae {
 
+	namespace
+	{
+		// Up to this many spheres a linear batched test is cheaper than walking the top level hierarchy for them
+		constexpr size_t maxBatchedSpheres{ 64 };
+	}
+
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
 	Scene::Scene():
-		m_Materials({ new Material_SolidColor({1.f,0.f,0.f})})
+		m_Materials({ new Material_SolidColor({1.f,0.f,0.f})}),
+		m_MaterialTable({ m_Materials.front()->GetData() })
 	{
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
 		m_TriangleMeshGeometries.reserve(32);
 		m_Lights.reserve(32);
 		m_Materials.reserve(32);
+		m_MaterialTable.reserve(32);
 	}
 
 	Scene::~Scene()
@@ -39,147 +48,325 @@ namespace dae {
 		return m_Camera;
 	}
 
-	const bool dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
-	{	
-		// PLANES //
-		for (const Plane& plane : m_PlaneGeometries)
+	void Scene::UpdateTopLevelBVH(ThreadPool* pThreadPool)
+	{
+		for (TriangleMesh& mesh : m_TriangleMeshGeometries)
 		{
-			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
+			// same triangles, only a better hierarchy: the object bounds (and the image) don't change
+			mesh.geometry->InstallPendingBVH();
+
+			// shared geometry is only rebuilt once, but the bounds of every instance of it change
+			mesh.geometry->UpdateDeformation(pThreadPool);
+			if (mesh.geometryVersion != mesh.geometry->version)
+			{
+				mesh.geometryVersion = mesh.geometry->version;
+				mesh.UpdateTransformedAABB(mesh.worldTransform);
+				mesh.hasMoved = true;
+			}
+
+			if (mesh.hasMoved) m_IsDirty = true;
+			mesh.hasMoved = false;
 		}
 
-		// SPHERES //
-		for (const Sphere& sphere : m_SphereGeometries)
+		if (!m_IsDirty) return;
+		m_IsDirty = false;
+		++m_Version;
+
+		m_PlaneBatch.Set(m_PlaneGeometries);
+
+		const bool isSphereBatched{ m_SphereGeometries.size() <= maxBatchedSpheres };
+		if (isSphereBatched) m_SphereBatch.Set(m_SphereGeometries);
+		else m_SphereBatch.Clear();
+		m_NrTopLevelSpheres = isSphereBatched ? 0 : static_cast<uint32_t>(m_SphereGeometries.size());
+
+		std::vector<AABB> objectBounds{};
+		objectBounds.reserve(m_NrTopLevelSpheres + m_TriangleMeshGeometries.size());
+
+		for (uint32_t sphereIdx{}; sphereIdx < m_NrTopLevelSpheres; ++sphereIdx)
 		{
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
+			const Sphere& sphere{ m_SphereGeometries[sphereIdx] };
+			const Vector3 radius{ sphere.radius, sphere.radius, sphere.radius };
+			objectBounds.push_back({ sphere.origin - radius, sphere.origin + radius });
 		}
 
-		// TRIANGLEMESHES //
 		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
 		{
-			GeometryUtils::HitTest_TriangleMesh(mesh, ray, closestHit);
+			objectBounds.push_back({ mesh.transformedMinAABB, mesh.transformedMaxAABB });
 		}
 
-		return closestHit.didHit;
+		m_TopLevelBVH.Build(objectBounds);
 	}
 
-	const bool Scene::DoesHit(const Ray& ray) const
+	float Scene::GetMeshBVHBuildTime() const
 	{
-		const float storeDivide2A{ 0.5f };
-		const size_t nrTrianglePoints{ 3 };
+		std::vector<const TriangleMeshGeometry*> countedGeometries{};
+		float buildTimeMs{};
+
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		{
+			const TriangleMeshGeometry* pGeometry{ mesh.geometry.get() };
+			if (std::find(countedGeometries.begin(), countedGeometries.end(), pGeometry) != countedGeometries.end()) continue;
+
+			countedGeometries.emplace_back(pGeometry);
+			buildTimeMs += pGeometry->bvh.buildTimeMs;
+		}
+		return buildTimeMs;
+	}
+
+	const bool dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	{	
+		// PLANES + FEW SPHERES (batched) //
+		GeometryUtils::HitTest_Planes(m_PlaneBatch, ray, closestHit);
+		GeometryUtils::HitTest_Spheres(m_SphereBatch, ray, closestHit);
+
+		if (m_TopLevelBVH.IsEmpty())
+		{
+			if (closestHit.didHit) FinalizeHit(ray, closestHit);
+			return closestHit.didHit;
+		}
+
+		// SPHERES + TRIANGLEMESHES (top level hierarchy) //
+		const GeometryUtils::SlabRay slabRay{ ray };
+		const uint32_t nrSpheres{ m_NrTopLevelSpheres };
+
+		RenderCounters& counters{ RenderStats::GetThreadCounters() };
 
-		// i did not use the hitTest functions because it calculated more than needed when just trying to figure out if there was a hit // (so i dont use ignoreHitRecord)
+		const size_t maxStackSize{ 64 };
+		uint32_t nodeStack[maxStackSize];
+		size_t stackSize{};
+		nodeStack[stackSize++] = 0;
 
-		// PLANES
-		for (const Plane& plane : m_PlaneGeometries)
+		while (stackSize > 0)
 		{
-			const float tempDot{ Vector3::Dot(plane.normal, ray.direction) };
+			const BVHNode& node{ m_TopLevelBVH.nodes[nodeStack[--stackSize]] };
 
-			if (!FloatIsZero(tempDot))
+			++counters.boxTests;
+			if (GeometryUtils::SlabTest_BVHNode(node, slabRay, closestHit.t) == FLT_MAX) continue;
+
+			if (node.IsLeaf())
 			{
-				const float t{ Vector3::Dot(plane.origin - ray.origin, plane.normal) / tempDot };
+				for (uint32_t idx{ node.leftFirst }; idx < node.leftFirst + node.primitiveCount; ++idx)
+				{
+					const uint32_t objectIdx{ m_TopLevelBVH.primitiveIndices[idx] };
 
-				if (!(t <= ray.min || t >= ray.max)) return true;
+					if (objectIdx < nrSpheres) GeometryUtils::HitTest_Sphere(m_SphereGeometries[objectIdx], objectIdx, ray, closestHit);
+					else GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[objectIdx - nrSpheres], objectIdx - nrSpheres, ray, closestHit);
+				}
+				continue;
+			}
+
+			++counters.nodesVisited;
+			counters.boxTests += 2;
+
+			const BVHNode& leftChild{ m_TopLevelBVH.nodes[node.leftFirst] };
+			const BVHNode& rightChild{ m_TopLevelBVH.nodes[node.leftFirst + 1] };
+			const float leftDistance{ GeometryUtils::SlabTest_BVHNode(leftChild, slabRay, closestHit.t) };
+			const float rightDistance{ GeometryUtils::SlabTest_BVHNode(rightChild, slabRay, closestHit.t) };
+
+			// push the far child first so the near child is popped next
+			if (leftDistance <= rightDistance)
+			{
+				if (rightDistance != FLT_MAX) nodeStack[stackSize++] = node.leftFirst + 1;
+				if (leftDistance != FLT_MAX) nodeStack[stackSize++] = node.leftFirst;
+			}
+			else
+			{
+				if (leftDistance != FLT_MAX) nodeStack[stackSize++] = node.leftFirst;
+				if (rightDistance != FLT_MAX) nodeStack[stackSize++] = node.leftFirst + 1;
 			}
 		}
 
-		// SPHERES
-		for (const Sphere& sphere : m_SphereGeometries)
+		if (closestHit.didHit) FinalizeHit(ray, closestHit);
+		return closestHit.didHit;
+	}
+
+	void Scene::GetClosestHits(const RayPacket& packet, HitRecord (&closestHits)[rayPacketSize]) const
+	{
+		// PLANES + FEW SPHERES (batched) //
+		for (uint32_t lane{}; lane < rayPacketSize; ++lane)
 		{
-			const Vector3 tempVec{ ray.origin - sphere.origin };
-			const float B{ Vector3::Dot(ray.direction, tempVec) * 2.f };
-			const float radiusSquared{ sphere.radius * sphere.radius };
-			const float C{ tempVec.SqrMagnitude() - radiusSquared };
-			const float D{ B * B - 4.f * C };
+			GeometryUtils::HitTest_Planes(m_PlaneBatch, packet.rays[lane], closestHits[lane]);
+			GeometryUtils::HitTest_Spheres(m_SphereBatch, packet.rays[lane], closestHits[lane]);
+		}
 
-			if (D > 0.f)
-			{
-				const float sqrtfD{ sqrtf(D) };
-				const float t{ (-B - sqrtfD) * storeDivide2A };
+		if (m_TopLevelBVH.IsEmpty())
+		{
+			FinalizeHits(packet, closestHits);
+			return;
+		}
 
-				if (!(t <= ray.min || t >= ray.max)) return true;
+		// SPHERES + TRIANGLEMESHES (top level hierarchy) //
+		const GeometryUtils::SlabRayPacket slabPacket{ packet };
+		const uint32_t nrSpheres{ m_NrTopLevelSpheres };
+		const uint32_t allLanes{ (1u << rayPacketSize) - 1 };
 
-				// no need to check when inside sphere because you dont even see the shadows
-			}
+		float maxDistances[rayPacketSize];
+		float entryDistances[rayPacketSize];
+		for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+		{
+			maxDistances[lane] = closestHits[lane].t;
 		}
 
-		// TRIANGLEMESHES
-		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		RenderCounters& counters{ RenderStats::GetThreadCounters() };
+
+		const size_t maxStackSize{ 64 };
+		uint32_t nodeStack[maxStackSize];
+		uint32_t maskStack[maxStackSize];
+		size_t stackSize{};
+		nodeStack[stackSize] = 0;
+		maskStack[stackSize++] = allLanes;
+
+		while (stackSize > 0)
 		{
-			if (GeometryUtils::SlabTest_TriangleMesh(mesh, ray))
-			{
-				const size_t nrTriangles{ mesh.indices.size() / nrTrianglePoints };
+			const BVHNode& node{ m_TopLevelBVH.nodes[nodeStack[--stackSize]] };
 
-				for (size_t TriangleIdx{}; TriangleIdx < nrTriangles; ++TriangleIdx)
-				{
-					const Vector3 normal{ mesh.transformedNormals[TriangleIdx] };
+			++counters.boxTests;
+			const uint32_t nodeMask{ GeometryUtils::SlabTest_BVHNode(node, slabPacket, maxDistances, entryDistances) & maskStack[stackSize] };
+			if (nodeMask == 0) continue;
 
-					const float tempDot{ Vector3::Dot(normal, ray.direction) };
+			if (node.IsLeaf())
+			{
+				for (uint32_t idx{ node.leftFirst }; idx < node.leftFirst + node.primitiveCount; ++idx)
+				{
+					const uint32_t objectIdx{ m_TopLevelBVH.primitiveIndices[idx] };
 
-					if (!FloatIsZero(tempDot))  // not perpendicular
+					if (objectIdx < nrSpheres)
 					{
-						switch (mesh.cullMode)
+						for (uint32_t lane{}; lane < rayPacketSize; ++lane)
 						{
-						case TriangleCullMode::NoCulling:
-							break;
+							if (nodeMask & (1u << lane)) GeometryUtils::HitTest_Sphere(m_SphereGeometries[objectIdx], objectIdx, packet.rays[lane], closestHits[lane]);
+						}
+					}
+					else GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[objectIdx - nrSpheres], objectIdx - nrSpheres, packet, closestHits, nodeMask);
+				}
 
-						case TriangleCullMode::BackFaceCulling:
-							if (!(tempDot > 0.f)) continue;
-							break;
+				for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+				{
+					maxDistances[lane] = closestHits[lane].t;
+				}
+				continue;
+			}
 
-						case TriangleCullMode::FrontFaceCulling:
-							if (!(tempDot < 0.f)) continue;
-							break;
-						}
+			++counters.nodesVisited;
+			counters.boxTests += 2;
 
-						const Vector3 V0{ mesh.transformedPositions[mesh.indices[TriangleIdx * nrTrianglePoints]] };
+			float leftDistances[rayPacketSize];
+			float rightDistances[rayPacketSize];
+			const uint32_t leftMask{ GeometryUtils::SlabTest_BVHNode(m_TopLevelBVH.nodes[node.leftFirst], slabPacket, maxDistances, leftDistances) & nodeMask };
+			const uint32_t rightMask{ GeometryUtils::SlabTest_BVHNode(m_TopLevelBVH.nodes[node.leftFirst + 1], slabPacket, maxDistances, rightDistances) & nodeMask };
 
-						const float t{ Vector3::Dot(V0 - ray.origin, normal) / tempDot };
+			const float leftDistance{ GeometryUtils::GetClosestDistance(leftDistances, leftMask) };
+			const float rightDistance{ GeometryUtils::GetClosestDistance(rightDistances, rightMask) };
+			const bool leftIsNear{ leftDistance <= rightDistance };
 
-						if (!(t <= ray.min || t >= ray.max))
-						{
-							const Vector3 V1{ mesh.transformedPositions[mesh.indices[TriangleIdx * nrTrianglePoints + 1]] };
-							const Vector3 V2{ mesh.transformedPositions[mesh.indices[TriangleIdx * nrTrianglePoints + 2]] };
+			// push the far child first so the near child is popped next
+			if ((leftIsNear ? rightMask : leftMask) != 0)
+			{
+				nodeStack[stackSize] = leftIsNear ? node.leftFirst + 1 : node.leftFirst;
+				maskStack[stackSize++] = leftIsNear ? rightMask : leftMask;
+			}
+			if ((leftIsNear ? leftMask : rightMask) != 0)
+			{
+				nodeStack[stackSize] = leftIsNear ? node.leftFirst : node.leftFirst + 1;
+				maskStack[stackSize++] = leftIsNear ? leftMask : rightMask;
+			}
+		}
 
-							const Vector3 hitOrigin{ ray.direction * t + ray.origin };
+		FinalizeHits(packet, closestHits);
+	}
 
-							if (
-								(Vector3::Dot(Vector3::Cross(V1 - V0, hitOrigin - V0), normal) < 0.f) ||
-								(Vector3::Dot(Vector3::Cross(V2 - V1, hitOrigin - V1), normal) < 0.f) ||
-								(Vector3::Dot(Vector3::Cross(V0 - V2, hitOrigin - V2), normal) < 0.f)
-								) continue;
+	const bool Scene::DoesHit(const Ray& ray) const
+	{
+		// PLANES + FEW SPHERES (batched) //
+		if (GeometryUtils::HitTest_Planes(m_PlaneBatch, ray)) return true;
+		if (GeometryUtils::HitTest_Spheres(m_SphereBatch, ray)) return true;
 
-							return true;
+		if (m_TopLevelBVH.IsEmpty()) return false;
 
-							// MOLLER_TRUMBORE but less fps and noise in shadows
-							/*const Vector3 AB{ V1 - V0 };
-							const Vector3 AC{ V2 - V0 };
-							const float areaABC{ 0.5f * Vector3::Cross(AB, AC).Magnitude() };
+		// SPHERES + TRIANGLEMESHES (top level hierarchy) //
+		// no hit record and no front to back ordering needed, any blocker ends the query
+		const GeometryUtils::SlabRay slabRay{ ray };
+		const uint32_t nrSpheres{ m_NrTopLevelSpheres };
 
-							const Vector3 AP{ hitOrigin - V0 };
-							const Vector3 BP{ hitOrigin - V1 };
-							const Vector3 CP{ hitOrigin - V2 };
+		RenderCounters& counters{ RenderStats::GetThreadCounters() };
 
-							const float areaABP{ 0.5f * Vector3::Cross(AB, BP).Magnitude() };
-							const float areaACP{ 0.5f * Vector3::Cross(AC, CP).Magnitude() };
-							const float areaABCP{ areaABC };
+		const size_t maxStackSize{ 64 };
+		uint32_t nodeStack[maxStackSize];
+		size_t stackSize{};
+		nodeStack[stackSize++] = 0;
 
-							const float a{ areaABP / areaABCP };
-							const float b{ areaACP / areaABCP };
-							const float c{ 1.0f - a - b };
+		while (stackSize > 0)
+		{
+			const BVHNode& node{ m_TopLevelBVH.nodes[nodeStack[--stackSize]] };
 
-							if (a < 0.f || b < 0.f || c < 0.f || a + b + c > 1.f) continue;
+			++counters.boxTests;
+			if (GeometryUtils::SlabTest_BVHNode(node, slabRay, ray.max) == FLT_MAX) continue;
 
-							return true;*/
+			if (node.IsLeaf())
+			{
+				for (uint32_t idx{ node.leftFirst }; idx < node.leftFirst + node.primitiveCount; ++idx)
+				{
+					const uint32_t objectIdx{ m_TopLevelBVH.primitiveIndices[idx] };
 
-						}
+					if (objectIdx < nrSpheres)
+					{
+						if (GeometryUtils::HitTest_Sphere(m_SphereGeometries[objectIdx], ray)) return true;
 					}
+					else if (GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[objectIdx - nrSpheres], ray)) return true;
 				}
+				continue;
 			}
+
+			++counters.nodesVisited;
+
+			nodeStack[stackSize++] = node.leftFirst + 1;
+			nodeStack[stackSize++] = node.leftFirst;
 		}
-			
+
 		return false;
 	}
 
+	void Scene::FinalizeHit(const Ray& ray, HitRecord& hitRecord) const
+	{
+		hitRecord.origin = ray.direction * hitRecord.t + ray.origin;
+
+		switch (hitRecord.objectType)
+		{
+		case HitObjectType::Sphere:
+		{
+			const Sphere& sphere{ m_SphereGeometries[hitRecord.objectIdx] };
+			hitRecord.normal = (hitRecord.origin - sphere.origin).Normalized();
+			hitRecord.materialIndex = sphere.materialIndex;
+			break;
+		}
+
+		case HitObjectType::Plane:
+		{
+			const Plane& plane{ m_PlaneGeometries[hitRecord.objectIdx] };
+			hitRecord.normal = plane.normal;
+			hitRecord.materialIndex = plane.materialIndex;
+			break;
+		}
+
+		case HitObjectType::TriangleMesh:
+		{
+			// object space face normal back to world space
+			const TriangleMesh& mesh{ m_TriangleMeshGeometries[hitRecord.objectIdx] };
+			hitRecord.normal = mesh.worldTransform.TransformVector(mesh.geometry->triangleRecords[hitRecord.triangleIdx].normal);
+			hitRecord.materialIndex = mesh.materialIndex;
+			break;
+		}
+		}
+	}
+
+	void Scene::FinalizeHits(const RayPacket& packet, HitRecord (&hitRecords)[rayPacketSize]) const
+	{
+		for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+		{
+			if (hitRecords[lane].didHit) FinalizeHit(packet.rays[lane], hitRecords[lane]);
+		}
+	}
+
 	const std::vector<Plane>& Scene::GetPlaneGeometries() const
 	{
 		return m_PlaneGeometries;
@@ -188,37 +375,51 @@ namespace dae {
 #pragma region Scene Helpers
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
+		m_IsDirty = true;
 		m_SphereGeometries.emplace_back(origin, radius, materialIndex);
 		return &m_SphereGeometries.back();
 	}
 
 	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
 	{
+		m_IsDirty = true;
 		m_PlaneGeometries.emplace_back(origin, normal, materialIndex);
 		return &m_PlaneGeometries.back();
 	}
 
 	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
 	{
+		m_IsDirty = true;
 		m_TriangleMeshGeometries.emplace_back(cullMode, materialIndex);
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	TriangleMesh* Scene::AddTriangleMeshInstance(const TriangleMesh& source, TriangleCullMode cullMode, unsigned char materialIndex)
+	{
+		m_IsDirty = true;
+		m_TriangleMeshGeometries.emplace_back(source.geometry, cullMode, materialIndex);
+		return &m_TriangleMeshGeometries.back();
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
+		m_IsDirty = true;
 		m_Lights.emplace_back(origin, intensity, color, LightType::Point);
 		return &m_Lights.back();
 	}
 
 	Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
 	{
+		m_IsDirty = true;
 		m_Lights.emplace_back(direction, intensity, color);
 		return &m_Lights.back();
 	}
 
 	unsigned char Scene::AddMaterial(Material* pMaterial)
 	{
+		m_IsDirty = true;
 		m_Materials.emplace_back(pMaterial);
+		m_MaterialTable.emplace_back(pMaterial->GetData());
 		return static_cast<unsigned char>(m_Materials.size() - 1);
 	}
 #pragma endregion
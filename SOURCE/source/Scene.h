@@ -1,6 +1,7 @@
 #pragma once
 #include "DataTypes.h"
 #include "Camera.h"
+#include "Material.h"
 
 namespace dae
 {
@@ -15,6 +16,7 @@ namespace dae
 	struct Camera;
 
 	class Timer;
+	class ThreadPool;
 	class Material;
 
 	//Scene Base Class
@@ -29,11 +31,27 @@ namespace dae
 		Scene& operator=(const Scene&) = delete;
 		Scene& operator=(Scene&&) noexcept = delete;
 
-		virtual void Initialize() = 0;
+		// pThreadPool: the renderer's workers, for the load time work (big mesh hierarchies are built on it), only used during Initialize
+		virtual void Initialize(ThreadPool* pThreadPool) = 0;
 		virtual void Update(Timer* pTimer);
 
 		Camera& GetCamera();
+
+		// Rebuilds the top level hierarchy when objects were added or moved, each rebuild bumps the version
+		// Also the safe point where mesh hierarchies finished in the background get swapped in,
+		// and where deformed geometry gets its hierarchy rebuilt (on pThreadPool when given)
+		void UpdateTopLevelBVH(ThreadPool* pThreadPool = nullptr);
+		uint32_t GetVersion() const { return m_Version; }
+
+		// Time spent building the mesh hierarchies (shared geometry counted once, cached hierarchies count as 0)
+		float GetMeshBVHBuildTime() const;
+
 		const bool GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+
+		// Closest hit for every ray of a coherent packet (primary rays of a pixel quad), rays share the top level traversal
+		void GetClosestHits(const RayPacket& packet, HitRecord (&closestHits)[rayPacketSize]) const;
+
+		// Occlusion query (shadow rays): same hierarchies as GetClosestHit, but returns on the first hit between ray.min and ray.max
 		const bool DoesHit(const Ray& ray) const;
 
 		//bool isInsideTriangle(const Vector3& A, const Vector3& B, const Vector3& C, const Vector3& P) const;
@@ -41,7 +59,10 @@ namespace dae
 		const std::vector<Plane>& GetPlaneGeometries() const;
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
+
+		// Flat copy of the materials' parameters, indexed by HitRecord::materialIndex (what the renderer shades with)
+		const std::vector<MaterialData>& GetMaterialTable() const { return m_MaterialTable; }
 
 	protected:
 		std::string	sceneName;
@@ -51,15 +72,36 @@ namespace dae
 		std::vector<TriangleMesh> m_TriangleMeshGeometries;
 		std::vector<Light> m_Lights;
 		std::vector<Material*> m_Materials;
+		std::vector<MaterialData> m_MaterialTable;
+
+		// Structure of arrays copies for the batched hit tests, refreshed with the top level hierarchy
+		// Spheres are only batched while there are few of them (maxBatchedSpheres), more go into the top level hierarchy
+		PlaneSoA m_PlaneBatch;
+		SphereSoA m_SphereBatch;
+		uint32_t m_NrTopLevelSpheres{};
+
+		// Top level hierarchy over the bounded objects (unbatched spheres first, then triangle meshes), planes are tested separately
+		BVH m_TopLevelBVH;
+		uint32_t m_Version{};
+		bool m_IsDirty{ true };
 
 		Camera m_Camera;
 
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		TriangleMesh* AddTriangleMeshInstance(const TriangleMesh& source, TriangleCullMode cullMode, unsigned char materialIndex = 0);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
 		unsigned char AddMaterial(Material* pMaterial);
+
+		// for changes the scene can't see itself (editing spheres, planes or lights in Update)
+		void MarkChanged() { m_IsDirty = true; }
+
+	private:
+		// Builds the surface data (origin, normal, material) of the closest hit, the traversal only keeps t and what was hit
+		void FinalizeHit(const Ray& ray, HitRecord& hitRecord) const;
+		void FinalizeHits(const RayPacket& packet, HitRecord (&hitRecords)[rayPacketSize]) const;
 	};
 }
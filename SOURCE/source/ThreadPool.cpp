@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cassert>
+
+#include "ThreadPool.h"
+
+namespace dae
+{
+	ThreadPool::ThreadPool(uint32_t nrWorkers)
+		: m_Queues(nrWorkers ? nrWorkers : std::max(1u, std::thread::hardware_concurrency()))
+	{
+		// worker 0 is the thread calling ParallelFor
+		m_Threads.reserve(m_Queues.size() - 1);
+		for (uint32_t workerIdx{ 1 }; workerIdx < m_Queues.size(); ++workerIdx)
+		{
+			m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, workerIdx);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+	{
+		if (nrTasks == 0) return;
+
+		assert(m_RemainingTasks == 0 && "ParallelFor can't be nested");
+
+		m_pTask = &task;
+		m_RemainingTasks = nrTasks;
+
+		// hand out consecutive blocks so neighbouring tasks (tiles) start on the same worker
+		const uint32_t nrWorkers{ GetNrOfWorkers() };
+		for (uint32_t workerIdx{}; workerIdx < nrWorkers; ++workerIdx)
+		{
+			const uint32_t first{ static_cast<uint32_t>(uint64_t{ nrTasks } * workerIdx / nrWorkers) };
+			const uint32_t last{ static_cast<uint32_t>(uint64_t{ nrTasks } * (workerIdx + 1) / nrWorkers) };
+
+			TaskQueue& queue{ m_Queues[workerIdx] };
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			for (uint32_t taskIdx{ first }; taskIdx < last; ++taskIdx)
+			{
+				queue.tasks.push_back(taskIdx);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		while (RunTask(0))
+		{
+		}
+
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this] { return m_RemainingTasks == 0; });
+		m_pTask = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t workerIdx)
+	{
+		uint64_t seenGeneration{ 0 };
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [&] { return m_IsStopping || m_Generation != seenGeneration; });
+
+				if (m_IsStopping) return;
+				seenGeneration = m_Generation;
+			}
+
+			while (RunTask(workerIdx))
+			{
+			}
+		}
+	}
+
+	bool ThreadPool::RunTask(uint32_t workerIdx)
+	{
+		const uint32_t nrWorkers{ GetNrOfWorkers() };
+
+		bool hasTask{ false };
+		uint32_t taskIdx{};
+
+		// own queue first (front), then steal from the others (back)
+		for (uint32_t offset{}; offset < nrWorkers && !hasTask; ++offset)
+		{
+			TaskQueue& queue{ m_Queues[(workerIdx + offset) % nrWorkers] };
+
+			std::lock_guard<std::mutex> lock{ queue.mutex };
+			if (queue.tasks.empty()) continue;
+
+			if (offset == 0)
+			{
+				taskIdx = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			else
+			{
+				taskIdx = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+			hasTask = true;
+		}
+
+		if (!hasTask) return false;
+
+		(*m_pTask)(taskIdx);
+
+		if (--m_RemainingTasks == 0)
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_DoneCondition.notify_all();
+		}
+
+		return true;
+	}
+}
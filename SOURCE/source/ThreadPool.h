@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	// Persistent worker threads with one task queue per worker.
+	// A worker takes tasks from the front of its own queue and steals from the back of the others once it runs dry,
+	// so uneven tasks (busy tiles vs empty sky) still balance out.
+	class ThreadPool final
+	{
+	public:
+		// nrWorkers includes the calling thread, 0 = one worker per hardware thread
+		explicit ThreadPool(uint32_t nrWorkers = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		// Runs task(taskIdx) for every taskIdx in [0, nrTasks) and blocks until all are done, the calling thread helps out
+		// Consecutive tasks start on the same worker (locality), not meant to be called from inside a task
+		void ParallelFor(uint32_t nrTasks, const std::function<void(uint32_t)>& task);
+
+		uint32_t GetNrOfWorkers() const { return static_cast<uint32_t>(m_Queues.size()); }
+
+	private:
+		struct TaskQueue
+		{
+			std::mutex mutex{};
+			std::deque<uint32_t> tasks{};
+		};
+
+		void WorkerLoop(uint32_t workerIdx);
+		bool RunTask(uint32_t workerIdx);
+
+		std::vector<TaskQueue> m_Queues;
+		std::vector<std::thread> m_Threads{};
+
+		const std::function<void(uint32_t)>* m_pTask{ nullptr };
+		std::atomic<uint32_t> m_RemainingTasks{ 0 };
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+		uint64_t m_Generation{ 0 };
+		bool m_IsStopping{ false };
+	};
+}
@@ -1,8 +1,10 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
-#include <fstream>
 #include "Math.h"
 #include "DataTypes.h"
+#include "OBJParser.h"
+#include "RenderStats.h"
 
 namespace dae
 {
@@ -22,8 +24,18 @@ namespace dae
 		}*/
 
 
+		// Closest hit bookkeeping during traversal, the surface data is only built once for the final hit (see Scene::GetClosestHit)
+		inline void RecordHit(HitRecord& hitRecord, const float t, const HitObjectType objectType, const uint32_t objectIdx)
+		{
+			hitRecord.didHit = true;
+			hitRecord.t = t;
+			hitRecord.objectType = objectType;
+			hitRecord.objectIdx = objectIdx;
+		}
+
 		//SPHERE HIT-TESTS //
-		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord)
+		// sphereIdx: index of the sphere in the scene, kept in the hit record
+		inline bool HitTest_Sphere(const Sphere& sphere, const uint32_t sphereIdx, const Ray& ray, HitRecord& hitRecord)
 		{
 			const Vector3 tempVec{ ray.origin - sphere.origin };
 			const float B{ Vector3::Dot(ray.direction, tempVec) * 2.f };
@@ -39,14 +51,7 @@ namespace dae
 
 				if (!(t <= ray.min || t >= ray.max))
 				{
-					if (t < hitRecord.t)
-					{
-						hitRecord.didHit = true;
-						hitRecord.t = t;
-						hitRecord.materialIndex = sphere.materialIndex;
-						hitRecord.origin = ray.direction * t + ray.origin;
-						hitRecord.normal = (hitRecord.origin - sphere.origin).Normalized();
-					}
+					if (t < hitRecord.t) RecordHit(hitRecord, t, HitObjectType::Sphere, sphereIdx);
 					return true;
 				}
 
@@ -54,24 +59,34 @@ namespace dae
 
 				if (!(t <= ray.min || t >= ray.max))
 				{
-					if (t < hitRecord.t)
-					{
-						hitRecord.didHit = true;
-						hitRecord.t = t;
-						hitRecord.materialIndex = sphere.materialIndex;
-						hitRecord.origin = ray.direction * t + ray.origin;
-						hitRecord.normal = (hitRecord.origin - sphere.origin).Normalized();
-					}
+					if (t < hitRecord.t) RecordHit(hitRecord, t, HitObjectType::Sphere, sphereIdx);
 					return true;
 				}
 			}
 			return false;
 		}
 
+		// Any hit query (shadow rays): only the nearest root is checked, a shadow ray can't start inside a sphere we can see
+		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
+		{
+			const Vector3 tempVec{ ray.origin - sphere.origin };
+			const float B{ Vector3::Dot(ray.direction, tempVec) * 2.f };
+			const float C{ tempVec.SqrMagnitude() - sphere.radius * sphere.radius };
+			const float D{ B * B - 4.f * C };
+
+			if (D <= 0.f) return false;
+
+			const float storeDivide2A{ 0.5f };
+			const float t{ (-B - sqrtf(D)) * storeDivide2A };
+
+			return !(t <= ray.min || t >= ray.max);
+		}
+
 #pragma endregion
 #pragma region Plane HitTest
 		//PLANE HIT-TESTS //
-		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord)
+		// planeIdx: index of the plane in the scene, kept in the hit record
+		inline bool HitTest_Plane(const Plane& plane, const uint32_t planeIdx, const Ray& ray, HitRecord& hitRecord)
 		{
 			const float tempDot{ Vector3::Dot(plane.normal, ray.direction) };
 
@@ -81,20 +96,281 @@ namespace dae
 
 			if (!(t <= ray.min || t >= ray.max))
 			{
-				if (t < hitRecord.t)
-				{
-					hitRecord.didHit = true;
-					hitRecord.t = t;
-					hitRecord.materialIndex = plane.materialIndex;
-					hitRecord.origin = ray.direction * t + ray.origin;
-					hitRecord.normal = plane.normal;
-				}
+				if (t < hitRecord.t) RecordHit(hitRecord, t, HitObjectType::Plane, planeIdx);
 				return true;
 			}
 			
 			return false;
 		}
 
+		// Any hit query (shadow rays)
+		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
+		{
+			const float tempDot{ Vector3::Dot(plane.normal, ray.direction) };
+
+			if (FloatIsZero(tempDot)) return false;
+
+			const float t{ Vector3::Dot((plane.origin - ray.origin), plane.normal) / tempDot };
+
+			return !(t <= ray.min || t >= ray.max);
+		}
+
+#pragma endregion
+#pragma region Batched Sphere/Plane HitTest
+#ifdef DAE_SIMD_SSE
+		// Nearest of the per lane closest hits (ties go to the lowest index, like testing the primitives one by one)
+		// Lanes that found nothing still hold maxDistance, returns false when none of them found anything
+		inline bool GetClosestLane(const __m128 laneDistances, const __m128i laneIndices, const float maxDistance, float& distance, uint32_t& primitiveIdx)
+		{
+			alignas(16) float distances[primitiveGroupSize];
+			alignas(16) uint32_t indices[primitiveGroupSize];
+			_mm_store_ps(distances, laneDistances);
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), laneIndices);
+
+			bool isHit{ false };
+			for (uint32_t lane{}; lane < primitiveGroupSize; ++lane)
+			{
+				if (!(distances[lane] < maxDistance)) continue;
+
+				if (!isHit || distances[lane] < distance || (distances[lane] == distance && indices[lane] < primitiveIdx))
+				{
+					isHit = true;
+					distance = distances[lane];
+					primitiveIdx = indices[lane];
+				}
+			}
+			return isHit;
+		}
+
+		inline __m128 Select(const __m128 mask, const __m128 ifTrue, const __m128 ifFalse)
+		{
+			return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+		}
+
+		// Near/far root of 4 ray/sphere pairs, hitMask gets the spheres the ray crosses at all (positive discriminant)
+		inline void IntersectSpheres4(const SphereSoA& spheres, const size_t firstIdx, const __m128 (&origin)[3], const __m128 (&direction)[3],
+			__m128& nearT, __m128& farT, __m128& hitMask)
+		{
+			const __m128 toRayX{ _mm_sub_ps(origin[0], _mm_loadu_ps(&spheres.originX[firstIdx])) };
+			const __m128 toRayY{ _mm_sub_ps(origin[1], _mm_loadu_ps(&spheres.originY[firstIdx])) };
+			const __m128 toRayZ{ _mm_sub_ps(origin[2], _mm_loadu_ps(&spheres.originZ[firstIdx])) };
+
+			const __m128 B{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(direction[0], toRayX), _mm_mul_ps(direction[1], toRayY)), _mm_mul_ps(direction[2], toRayZ)),
+				_mm_set1_ps(2.f)) };
+			const __m128 C{ _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toRayX, toRayX), _mm_mul_ps(toRayY, toRayY)), _mm_mul_ps(toRayZ, toRayZ)),
+				_mm_loadu_ps(&spheres.radiusSquared[firstIdx])) };
+			const __m128 D{ _mm_sub_ps(_mm_mul_ps(B, B), _mm_mul_ps(_mm_set1_ps(4.f), C)) };
+
+			hitMask = _mm_cmpgt_ps(D, _mm_setzero_ps());
+
+			// NaN for the missed lanes, they are masked out by hitMask
+			const __m128 sqrtD{ _mm_sqrt_ps(D) };
+			const __m128 minusB{ _mm_sub_ps(_mm_setzero_ps(), B) };
+			const __m128 half{ _mm_set1_ps(0.5f) };
+			nearT = _mm_mul_ps(_mm_sub_ps(minusB, sqrtD), half);
+			farT = _mm_mul_ps(_mm_add_ps(minusB, sqrtD), half);
+		}
+
+		// Distance to 4 planes, hitMask gets the planes the ray isn't parallel to
+		inline __m128 IntersectPlanes4(const PlaneSoA& planes, const size_t firstIdx, const __m128 (&origin)[3], const __m128 (&direction)[3], __m128& hitMask)
+		{
+			const __m128 normalX{ _mm_loadu_ps(&planes.normalX[firstIdx]) };
+			const __m128 normalY{ _mm_loadu_ps(&planes.normalY[firstIdx]) };
+			const __m128 normalZ{ _mm_loadu_ps(&planes.normalZ[firstIdx]) };
+
+			const __m128 tempDot{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, direction[0]), _mm_mul_ps(normalY, direction[1])), _mm_mul_ps(normalZ, direction[2])) };
+
+			// |tempDot| >= FLT_EPSILON, see FloatIsZero
+			const __m128 absoluteDot{ _mm_andnot_ps(_mm_set1_ps(-0.f), tempDot) };
+			hitMask = _mm_cmpge_ps(absoluteDot, _mm_set1_ps(FLT_EPSILON));
+
+			const __m128 toPlaneX{ _mm_sub_ps(_mm_loadu_ps(&planes.originX[firstIdx]), origin[0]) };
+			const __m128 toPlaneY{ _mm_sub_ps(_mm_loadu_ps(&planes.originY[firstIdx]), origin[1]) };
+			const __m128 toPlaneZ{ _mm_sub_ps(_mm_loadu_ps(&planes.originZ[firstIdx]), origin[2]) };
+
+			return _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toPlaneX, normalX), _mm_mul_ps(toPlaneY, normalY)), _mm_mul_ps(toPlaneZ, normalZ)), tempDot);
+		}
+
+		inline __m128 IsInRange(const __m128 t, const __m128 minDistance, const __m128 maxDistance)
+		{
+			return _mm_and_ps(_mm_cmpgt_ps(t, minDistance), _mm_cmplt_ps(t, maxDistance));
+		}
+#endif
+
+		// Closest hit over all spheres of the batch, 4 at a time, returns whether one was closer than hitRecord.t
+		// The batch holds the scene's spheres in order, so the recorded index is the scene's sphere index
+		inline bool HitTest_Spheres(const SphereSoA& spheres, const Ray& ray, HitRecord& hitRecord)
+		{
+#ifdef DAE_SIMD_SSE
+			const __m128 origin[3]{ _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) };
+			const __m128 direction[3]{ _mm_set1_ps(ray.direction.x), _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z) };
+			const __m128 minDistance{ _mm_set1_ps(ray.min) };
+			const __m128 maxDistance{ _mm_set1_ps(ray.max) };
+
+			__m128 closestDistances{ _mm_set1_ps(hitRecord.t) };
+			__m128i closestIndices{ _mm_setzero_si128() };
+			__m128i indices{ _mm_setr_epi32(0, 1, 2, 3) };
+
+			for (size_t idx{}; idx < spheres.GetPaddedSize(); idx += primitiveGroupSize)
+			{
+				__m128 nearT, farT, hitMask;
+				IntersectSpheres4(spheres, idx, origin, direction, nearT, farT, hitMask);
+
+				// near root when it is in range, else the far one (ray starts inside)
+				const __m128 isNearInRange{ IsInRange(nearT, minDistance, maxDistance) };
+				const __m128 t{ Select(isNearInRange, nearT, farT) };
+
+				hitMask = _mm_and_ps(hitMask, _mm_or_ps(isNearInRange, IsInRange(farT, minDistance, maxDistance)));
+				hitMask = _mm_and_ps(hitMask, _mm_cmplt_ps(t, closestDistances));
+
+				closestDistances = Select(hitMask, t, closestDistances);
+				closestIndices = _mm_castps_si128(Select(hitMask, _mm_castsi128_ps(indices), _mm_castsi128_ps(closestIndices)));
+				indices = _mm_add_epi32(indices, _mm_set1_epi32(primitiveGroupSize));
+			}
+
+			float t{};
+			uint32_t sphereIdx{};
+			if (!GetClosestLane(closestDistances, closestIndices, hitRecord.t, t, sphereIdx)) return false;
+
+			RecordHit(hitRecord, t, HitObjectType::Sphere, sphereIdx);
+			return true;
+#else
+			bool isHit{ false };
+			for (size_t idx{}; idx < spheres.GetPaddedSize(); ++idx)
+			{
+				const Vector3 toRay{ ray.origin - Vector3{ spheres.originX[idx], spheres.originY[idx], spheres.originZ[idx] } };
+				const float B{ Vector3::Dot(ray.direction, toRay) * 2.f };
+				const float D{ B * B - 4.f * (toRay.SqrMagnitude() - spheres.radiusSquared[idx]) };
+				if (!(D > 0.f)) continue;
+
+				const float sqrtfD{ sqrtf(D) };
+				float t{ (-B - sqrtfD) * 0.5f };
+				if (t <= ray.min || t >= ray.max) t = (-B + sqrtfD) * 0.5f;
+				if (t <= ray.min || t >= ray.max || t >= hitRecord.t) continue;
+
+				RecordHit(hitRecord, t, HitObjectType::Sphere, static_cast<uint32_t>(idx));
+				isHit = true;
+			}
+			return isHit;
+#endif
+		}
+
+		// Any hit query (shadow rays), nearest root only like HitTest_Sphere(sphere, ray)
+		inline bool HitTest_Spheres(const SphereSoA& spheres, const Ray& ray)
+		{
+#ifdef DAE_SIMD_SSE
+			const __m128 origin[3]{ _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) };
+			const __m128 direction[3]{ _mm_set1_ps(ray.direction.x), _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z) };
+			const __m128 minDistance{ _mm_set1_ps(ray.min) };
+			const __m128 maxDistance{ _mm_set1_ps(ray.max) };
+
+			for (size_t idx{}; idx < spheres.GetPaddedSize(); idx += primitiveGroupSize)
+			{
+				__m128 nearT, farT, hitMask;
+				IntersectSpheres4(spheres, idx, origin, direction, nearT, farT, hitMask);
+
+				if (_mm_movemask_ps(_mm_and_ps(hitMask, IsInRange(nearT, minDistance, maxDistance)))) return true;
+			}
+			return false;
+#else
+			for (size_t idx{}; idx < spheres.GetPaddedSize(); ++idx)
+			{
+				const Vector3 toRay{ ray.origin - Vector3{ spheres.originX[idx], spheres.originY[idx], spheres.originZ[idx] } };
+				const float B{ Vector3::Dot(ray.direction, toRay) * 2.f };
+				const float D{ B * B - 4.f * (toRay.SqrMagnitude() - spheres.radiusSquared[idx]) };
+				if (!(D > 0.f)) continue;
+
+				const float t{ (-B - sqrtf(D)) * 0.5f };
+				if (!(t <= ray.min || t >= ray.max)) return true;
+			}
+			return false;
+#endif
+		}
+
+		// Closest hit over all planes of the batch, 4 at a time, returns whether one was closer than hitRecord.t
+		// The batch holds the scene's planes in order, so the recorded index is the scene's plane index
+		inline bool HitTest_Planes(const PlaneSoA& planes, const Ray& ray, HitRecord& hitRecord)
+		{
+#ifdef DAE_SIMD_SSE
+			const __m128 origin[3]{ _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) };
+			const __m128 direction[3]{ _mm_set1_ps(ray.direction.x), _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z) };
+			const __m128 minDistance{ _mm_set1_ps(ray.min) };
+			const __m128 maxDistance{ _mm_set1_ps(ray.max) };
+
+			__m128 closestDistances{ _mm_set1_ps(hitRecord.t) };
+			__m128i closestIndices{ _mm_setzero_si128() };
+			__m128i indices{ _mm_setr_epi32(0, 1, 2, 3) };
+
+			for (size_t idx{}; idx < planes.GetPaddedSize(); idx += primitiveGroupSize)
+			{
+				__m128 hitMask;
+				const __m128 t{ IntersectPlanes4(planes, idx, origin, direction, hitMask) };
+
+				hitMask = _mm_and_ps(hitMask, IsInRange(t, minDistance, maxDistance));
+				hitMask = _mm_and_ps(hitMask, _mm_cmplt_ps(t, closestDistances));
+
+				closestDistances = Select(hitMask, t, closestDistances);
+				closestIndices = _mm_castps_si128(Select(hitMask, _mm_castsi128_ps(indices), _mm_castsi128_ps(closestIndices)));
+				indices = _mm_add_epi32(indices, _mm_set1_epi32(primitiveGroupSize));
+			}
+
+			float t{};
+			uint32_t planeIdx{};
+			if (!GetClosestLane(closestDistances, closestIndices, hitRecord.t, t, planeIdx)) return false;
+
+			RecordHit(hitRecord, t, HitObjectType::Plane, planeIdx);
+			return true;
+#else
+			bool isHit{ false };
+			for (size_t idx{}; idx < planes.GetPaddedSize(); ++idx)
+			{
+				const Vector3 normal{ planes.normalX[idx], planes.normalY[idx], planes.normalZ[idx] };
+				const float tempDot{ Vector3::Dot(normal, ray.direction) };
+				if (FloatIsZero(tempDot)) continue;
+
+				const Vector3 planeOrigin{ planes.originX[idx], planes.originY[idx], planes.originZ[idx] };
+				const float t{ Vector3::Dot((planeOrigin - ray.origin), normal) / tempDot };
+				if (t <= ray.min || t >= ray.max || t >= hitRecord.t) continue;
+
+				RecordHit(hitRecord, t, HitObjectType::Plane, static_cast<uint32_t>(idx));
+				isHit = true;
+			}
+			return isHit;
+#endif
+		}
+
+		// Any hit query (shadow rays)
+		inline bool HitTest_Planes(const PlaneSoA& planes, const Ray& ray)
+		{
+#ifdef DAE_SIMD_SSE
+			const __m128 origin[3]{ _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) };
+			const __m128 direction[3]{ _mm_set1_ps(ray.direction.x), _mm_set1_ps(ray.direction.y), _mm_set1_ps(ray.direction.z) };
+			const __m128 minDistance{ _mm_set1_ps(ray.min) };
+			const __m128 maxDistance{ _mm_set1_ps(ray.max) };
+
+			for (size_t idx{}; idx < planes.GetPaddedSize(); idx += primitiveGroupSize)
+			{
+				__m128 hitMask;
+				const __m128 t{ IntersectPlanes4(planes, idx, origin, direction, hitMask) };
+
+				if (_mm_movemask_ps(_mm_and_ps(hitMask, IsInRange(t, minDistance, maxDistance)))) return true;
+			}
+			return false;
+#else
+			for (size_t idx{}; idx < planes.GetPaddedSize(); ++idx)
+			{
+				const Vector3 normal{ planes.normalX[idx], planes.normalY[idx], planes.normalZ[idx] };
+				const float tempDot{ Vector3::Dot(normal, ray.direction) };
+				if (FloatIsZero(tempDot)) continue;
+
+				const Vector3 planeOrigin{ planes.originX[idx], planes.originY[idx], planes.originZ[idx] };
+				const float t{ Vector3::Dot((planeOrigin - ray.origin), normal) / tempDot };
+				if (!(t <= ray.min || t >= ray.max)) return true;
+			}
+			return false;
+#endif
+		}
+
 #pragma endregion
 
 #pragma region TriangeMesh HitTest
@@ -157,68 +433,567 @@ namespace dae
 			//return txmax > 0 && txmax > txmin;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord)
+		// Returns the distance at which the ray enters the box, FLT_MAX when it misses or enters beyond maxDistance
+		inline float SlabTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const Vector3& rayOrigin, const Vector3& dirInv, const float maxDistance)
 		{
-			if (!GeometryUtils::SlabTest_TriangleMesh(mesh, ray)) return false;
+			const float tx1{ (minAABB.x - rayOrigin.x) * dirInv.x };
+			const float tx2{ (maxAABB.x - rayOrigin.x) * dirInv.x };
+			float tmin{ std::min(tx1, tx2) };
+			float tmax{ std::max(tx1, tx2) };
+
+			const float ty1{ (minAABB.y - rayOrigin.y) * dirInv.y };
+			const float ty2{ (maxAABB.y - rayOrigin.y) * dirInv.y };
+			tmin = std::max(tmin, std::min(ty1, ty2));
+			tmax = std::min(tmax, std::max(ty1, ty2));
+
+			const float tz1{ (minAABB.z - rayOrigin.z) * dirInv.z };
+			const float tz2{ (maxAABB.z - rayOrigin.z) * dirInv.z };
+			tmin = std::max(tmin, std::min(tz1, tz2));
+			tmax = std::min(tmax, std::max(tz1, tz2));
+
+			if (tmax >= tmin && tmax > 0.f && tmin < maxDistance) return tmin;
+			return FLT_MAX;
+		}
+
+		// Ray data for the BVH node slab tests, set up once per traversal
+		struct SlabRay
+		{
+			explicit SlabRay(const Ray& ray)
+#ifdef DAE_SIMD_SSE
+				: origin{ _mm_setr_ps(ray.origin.x, ray.origin.y, ray.origin.z, 0.f) },
+				dirInv{ _mm_setr_ps(1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z, 0.f) },
+				originLanes{ _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) },
+				dirInvLanes{ _mm_shuffle_ps(dirInv, dirInv, _MM_SHUFFLE(0, 0, 0, 0)),
+					_mm_shuffle_ps(dirInv, dirInv, _MM_SHUFFLE(1, 1, 1, 1)),
+					_mm_shuffle_ps(dirInv, dirInv, _MM_SHUFFLE(2, 2, 2, 2)) }
+			{
+			}
+
+			__m128 origin;
+			__m128 dirInv;
 
-			const size_t nrTrianglePoints{ 3 };
+			// every axis broadcast to all lanes, for the wide node test (4 boxes, one ray)
+			__m128 originLanes[3];
+			__m128 dirInvLanes[3];
+#else
+				: origin{ ray.origin },
+				dirInv{ 1.f / ray.direction }
+			{
+			}
+
+			Vector3 origin;
+			Vector3 dirInv;
+#endif
+		};
+
+		// Same result as SlabTest_AABB (entry distance or FLT_MAX), all three slabs at once
+		inline float SlabTest_BVHNode(const BVHNode& node, const SlabRay& slabRay, const float maxDistance)
+		{
+#ifdef DAE_SIMD_SSE
+			const __m128 t1{ _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.minAABB.x), slabRay.origin), slabRay.dirInv) };
+			const __m128 t2{ _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.maxAABB.x), slabRay.origin), slabRay.dirInv) };
+
+			// operand order matches std::min/std::max so NaN slabs (ray parallel to a face) behave like the scalar test
+			const __m128 tNear{ _mm_min_ps(t2, t1) };
+			const __m128 tFar{ _mm_max_ps(t2, t1) };
+
+			// lane 3 holds garbage from the node, only x/y/z are reduced
+			const __m128 tmin{ _mm_max_ss(_mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(2, 2, 2, 2)),
+				_mm_max_ss(_mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(1, 1, 1, 1)), tNear)) };
+			const __m128 tmax{ _mm_min_ss(_mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(2, 2, 2, 2)),
+				_mm_min_ss(_mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(1, 1, 1, 1)), tFar)) };
+
+			const float entry{ _mm_cvtss_f32(tmin) };
+			const float exit{ _mm_cvtss_f32(tmax) };
+
+			if (exit >= entry && exit > 0.f && entry < maxDistance) return entry;
+			return FLT_MAX;
+#else
+			return SlabTest_AABB(node.minAABB, node.maxAABB, slabRay.origin, slabRay.dirInv, maxDistance);
+#endif
+		}
+
+		// Rays of a packet in SoA layout for the packet slab test, set up once per traversal
+		struct SlabRayPacket
+		{
+			explicit SlabRayPacket(const RayPacket& packet)
+			{
+				for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+				{
+					const Ray& ray{ packet.rays[lane] };
+					originX[lane] = ray.origin.x;
+					originY[lane] = ray.origin.y;
+					originZ[lane] = ray.origin.z;
+					dirInvX[lane] = 1.f / ray.direction.x;
+					dirInvY[lane] = 1.f / ray.direction.y;
+					dirInvZ[lane] = 1.f / ray.direction.z;
+				}
+			}
+
+			alignas(16) float originX[rayPacketSize];
+			alignas(16) float originY[rayPacketSize];
+			alignas(16) float originZ[rayPacketSize];
+			alignas(16) float dirInvX[rayPacketSize];
+			alignas(16) float dirInvY[rayPacketSize];
+			alignas(16) float dirInvZ[rayPacketSize];
+		};
+
+		inline uint32_t GetFirstLane(const uint32_t laneMask)
+		{
+			uint32_t lane{};
+			while (!(laneMask & (1u << lane))) ++lane;
+			return lane;
+		}
+
+		inline float GetClosestDistance(const float (&distances)[rayPacketSize], const uint32_t laneMask)
+		{
+			float closest{ FLT_MAX };
+			for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+			{
+				if (laneMask & (1u << lane)) closest = std::min(closest, distances[lane]);
+			}
+			return closest;
+		}
+
+#ifdef DAE_SIMD_SSE
+		// Slab test with one box/ray pair per lane (4 boxes against 1 ray or 1 box against 4 rays), all arguments per axis
+		// Returns the mask of the lanes that enter their box before maxDistances, tmin gets the entry distances
+		inline uint32_t SlabTest4(const __m128 (&minimum)[3], const __m128 (&maximum)[3], const __m128 (&origin)[3], const __m128 (&dirInv)[3],
+			const __m128 maxDistances, __m128& tmin)
+		{
+			__m128 tmax{ _mm_set1_ps(FLT_MAX) };
+			tmin = _mm_set1_ps(-FLT_MAX);
+
+			for (int axis{}; axis < 3; ++axis)
+			{
+				const __m128 t1{ _mm_mul_ps(_mm_sub_ps(minimum[axis], origin[axis]), dirInv[axis]) };
+				const __m128 t2{ _mm_mul_ps(_mm_sub_ps(maximum[axis], origin[axis]), dirInv[axis]) };
+
+				// operand order matches std::min/std::max so NaN slabs (ray parallel to a face) behave like the scalar test
+				tmin = _mm_max_ps(_mm_min_ps(t2, t1), tmin);
+				tmax = _mm_min_ps(_mm_max_ps(t2, t1), tmax);
+			}
+
+			const __m128 isHit{ _mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(tmax, tmin), _mm_cmpgt_ps(tmax, _mm_setzero_ps())),
+				_mm_cmplt_ps(tmin, maxDistances)) };
+
+			return static_cast<uint32_t>(_mm_movemask_ps(isHit));
+		}
+#endif
+
+		// One box against all rays of a packet, returns the lane mask of the rays that enter it before their maxDistance
+		// entryDistances gets the per ray entry distance (only meaningful for the lanes in the mask)
+		inline uint32_t SlabTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const SlabRayPacket& packet,
+			const float (&maxDistances)[rayPacketSize], float (&entryDistances)[rayPacketSize])
+		{
+#ifdef DAE_SIMD_SSE
+			static_assert(rayPacketSize == 4, "the SSE packet test handles 4 rays");
+
+			const __m128 minimum[3]{ _mm_set1_ps(minAABB.x), _mm_set1_ps(minAABB.y), _mm_set1_ps(minAABB.z) };
+			const __m128 maximum[3]{ _mm_set1_ps(maxAABB.x), _mm_set1_ps(maxAABB.y), _mm_set1_ps(maxAABB.z) };
+			const __m128 origin[3]{ _mm_load_ps(packet.originX), _mm_load_ps(packet.originY), _mm_load_ps(packet.originZ) };
+			const __m128 dirInv[3]{ _mm_load_ps(packet.dirInvX), _mm_load_ps(packet.dirInvY), _mm_load_ps(packet.dirInvZ) };
+
+			__m128 tmin;
+			const uint32_t laneMask{ SlabTest4(minimum, maximum, origin, dirInv, _mm_loadu_ps(maxDistances), tmin) };
+
+			_mm_storeu_ps(entryDistances, tmin);
+			return laneMask;
+#else
+			uint32_t laneMask{};
+			for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+			{
+				const Vector3 origin{ packet.originX[lane], packet.originY[lane], packet.originZ[lane] };
+				const Vector3 dirInv{ packet.dirInvX[lane], packet.dirInvY[lane], packet.dirInvZ[lane] };
+				entryDistances[lane] = SlabTest_AABB(minAABB, maxAABB, origin, dirInv, maxDistances[lane]);
+				if (entryDistances[lane] != FLT_MAX) laneMask |= 1u << lane;
+			}
+			return laneMask;
+#endif
+		}
+
+		inline uint32_t SlabTest_BVHNode(const BVHNode& node, const SlabRayPacket& packet, const float (&maxDistances)[rayPacketSize], float (&entryDistances)[rayPacketSize])
+		{
+			return SlabTest_AABB(node.minAABB, node.maxAABB, packet, maxDistances, entryDistances);
+		}
+
+		// All children of a wide node against one ray, returns the mask of the children it enters before maxDistance
+		// entryDistances gets the per child entry distance (only meaningful for the children in the mask)
+		inline uint32_t SlabTest_WideBVHNode(const WideBVHNode& node, const SlabRay& slabRay, const float maxDistance, float (&entryDistances)[wideBVHWidth])
+		{
+#ifdef DAE_SIMD_SSE
+			static_assert(wideBVHWidth == 4, "the SSE wide node test handles 4 children");
+
+			const __m128 minimum[3]{ _mm_load_ps(node.minX), _mm_load_ps(node.minY), _mm_load_ps(node.minZ) };
+			const __m128 maximum[3]{ _mm_load_ps(node.maxX), _mm_load_ps(node.maxY), _mm_load_ps(node.maxZ) };
+
+			__m128 tmin;
+			const uint32_t childMask{ SlabTest4(minimum, maximum, slabRay.originLanes, slabRay.dirInvLanes, _mm_set1_ps(maxDistance), tmin) };
+
+			const __m128i isEmpty{ _mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(node.primitiveCounts)), _mm_set1_epi32(-1)) };
+
+			_mm_storeu_ps(entryDistances, tmin);
+			return childMask & ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(isEmpty)));
+#else
+			uint32_t childMask{};
+			for (uint32_t slot{}; slot < wideBVHWidth; ++slot)
+			{
+				if (node.primitiveCounts[slot] == WideBVHNode::emptyChild) break;
+
+				const Vector3 minAABB{ node.minX[slot], node.minY[slot], node.minZ[slot] };
+				const Vector3 maxAABB{ node.maxX[slot], node.maxY[slot], node.maxZ[slot] };
+				entryDistances[slot] = SlabTest_AABB(minAABB, maxAABB, slabRay.origin, slabRay.dirInv, maxDistance);
+				if (entryDistances[slot] != FLT_MAX) childMask |= 1u << slot;
+			}
+			return childMask;
+#endif
+		}
+
+		// The children in childMask ordered far to near (push order: the nearest one gets popped first), returns how many there are
+		inline uint32_t SortChildrenFarToNear(const uint32_t childMask, const float (&distances)[wideBVHWidth], uint32_t (&slots)[wideBVHWidth])
+		{
+			uint32_t nrChildren{};
+			for (uint32_t slot{}; slot < wideBVHWidth; ++slot)
+			{
+				if (!(childMask & (1u << slot))) continue;
+
+				// insertion sort, at most 4 children
+				uint32_t insertIdx{ nrChildren++ };
+				while (insertIdx > 0 && distances[slots[insertIdx - 1]] < distances[slot])
+				{
+					slots[insertIdx] = slots[insertIdx - 1];
+					--insertIdx;
+				}
+				slots[insertIdx] = slot;
+			}
+			return nrChildren;
+		}
+
+		// Stack entry of the wide traversals: an inner node (primitiveCount 0) or a leaf range of primitiveIndices
+		struct WideTraversalEntry
+		{
+			uint32_t child;
+			uint32_t primitiveCount;
+			float distance;		// entry distance of the child's box (closest lane for packets)
+		};
+
+		// up to 3 entries per level (one of the 4 children is popped right away) of at most BVH::maxDepth levels
+		constexpr size_t maxWideStackSize{ 192 };
+		static_assert(maxWideStackSize >= (wideBVHWidth - 1) * BVH::maxDepth, "the wide traversal stack is too small for the deepest tree");
+
+		// Expects the ray in object space of the mesh, the hit record gets t, the barycentrics and triangleIdx (index into triangleRecords),
+		// the mesh itself is recorded by HitTest_TriangleMesh
+		// ignoreHitRecord: shadow ray query, the hit record is left untouched and the cull mode is flipped (ray leaves the surface)
+		inline bool HitTest_Triangle(const TriangleMesh& mesh, const uint32_t triangleIdx, const Ray& ray, HitRecord& hitRecord, const bool ignoreHitRecord = false)
+		{
+			const TriangleRecord& triangle{ mesh.geometry->triangleRecords[triangleIdx] };
+
+			const float tempDot{ Vector3::Dot(triangle.normal, ray.direction) };
+
+			if (FloatIsZero(tempDot)) return false; // perpendicular?
+
+			switch (mesh.cullMode)
+			{
+			case TriangleCullMode::NoCulling:
+				break;
+
+			case TriangleCullMode::BackFaceCulling:
+				if (ignoreHitRecord ? !(tempDot > 0.f) : !(tempDot < 0.f)) return false;
+				break;
+
+			case TriangleCullMode::FrontFaceCulling:
+				if (ignoreHitRecord ? !(tempDot < 0.f) : !(tempDot > 0.f)) return false;
+				break;
+			}
+
+			// Möller–Trumbore: barycentrics and t straight from the edges, no plane hit point needed
+			const Vector3 pVector{ Vector3::Cross(ray.direction, triangle.edge2) };
+			const float inverseDeterminant{ 1.f / Vector3::Dot(triangle.edge1, pVector) };
+
+			const Vector3 tVector{ ray.origin - triangle.v0 };
+			const Vector3 qVector{ Vector3::Cross(tVector, triangle.edge1) };
+
+			const float u{ Vector3::Dot(tVector, pVector) * inverseDeterminant };
+			const float v{ Vector3::Dot(ray.direction, qVector) * inverseDeterminant };
+			const float t{ Vector3::Dot(triangle.edge2, qVector) * inverseDeterminant };
+
+			const float maxDistance{ ignoreHitRecord ? ray.max : std::min(ray.max, hitRecord.t) };
+
+			// one combined test instead of a branch per condition, edges count as inside, NaN (degenerate triangle) fails
+			if (!((u >= 0.f) & (v >= 0.f) & (u + v <= 1.f) & (t > ray.min) & (t < maxDistance))) return false;
+
+			if (!ignoreHitRecord)
+			{
+				hitRecord.t = t;
+				hitRecord.u = u;
+				hitRecord.v = v;
+				hitRecord.triangleIdx = triangleIdx;
+			}
+
+			return true;
+		}
+
+		// Front to back traversal of the mesh hierarchy below wide node rootNodeIdx, children further away than the closest hit so far get skipped
+		// Expects the ray in object space, the hit record gets the object space normal
+		inline bool TraverseTriangleMesh(const TriangleMesh& mesh, const Ray& objectRay, const SlabRay& slabRay, HitRecord& hitRecord, const uint32_t rootNodeIdx = 0)
+		{
+			const BVH& bvh{ mesh.geometry->bvh };
 			bool returnValue{ false };
 
-			const size_t nrTriangles{ mesh.indices.size() / nrTrianglePoints };
+			RenderCounters& counters{ RenderStats::GetThreadCounters() };
+
+			WideTraversalEntry nodeStack[maxWideStackSize];
+			size_t stackSize{};
+			nodeStack[stackSize++] = { rootNodeIdx, 0, -FLT_MAX };
+
+			float childDistances[wideBVHWidth];
+			uint32_t childSlots[wideBVHWidth];
 
-			for (size_t triangleIdx{}; triangleIdx < nrTriangles; ++triangleIdx)
+			while (stackSize > 0)
 			{
-				const Vector3 normal{ mesh.transformedNormals[triangleIdx] };
+				const WideTraversalEntry entry{ nodeStack[--stackSize] };
 
-				const float tempDot{ Vector3::Dot(normal, ray.direction) };
+				// a closer hit may have been found since the entry was pushed
+				if (entry.distance >= hitRecord.t) continue;
 
-				if (!FloatIsZero(tempDot))  // perpendicular?
+				if (entry.primitiveCount > 0)
 				{
-					switch (mesh.cullMode)
+					counters.triangleTests += entry.primitiveCount;
+					for (uint32_t idx{ entry.child }; idx < entry.child + entry.primitiveCount; ++idx)
 					{
-					case TriangleCullMode::NoCulling:
-						break;
+						if (HitTest_Triangle(mesh, idx, objectRay, hitRecord)) returnValue = true;
+					}
+					continue;
+				}
+
+				++counters.nodesVisited;
+				counters.boxTests += wideBVHWidth;
+
+				const WideBVHNode& node{ bvh.wideNodes[entry.child] };
+				const uint32_t childMask{ SlabTest_WideBVHNode(node, slabRay, hitRecord.t, childDistances) };
+
+				// far to near, so the near child is popped next
+				const uint32_t nrChildren{ SortChildrenFarToNear(childMask, childDistances, childSlots) };
+				for (uint32_t childIdx{}; childIdx < nrChildren; ++childIdx)
+				{
+					const uint32_t slot{ childSlots[childIdx] };
+					nodeStack[stackSize++] = { node.children[slot], node.primitiveCounts[slot], childDistances[slot] };
+				}
+			}
+
+			return returnValue;
+		}
 
-					case TriangleCullMode::BackFaceCulling:
-						if (!(tempDot < 0.f)) continue;
-						break;
+		// meshIdx: index of the mesh in the scene, kept in the hit record
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const uint32_t meshIdx, const Ray& ray, HitRecord& hitRecord)
+		{
+			if (mesh.geometry->bvh.IsEmpty()) return false;
+
+			++RenderStats::GetThreadCounters().boxTests;
+			if (!GeometryUtils::SlabTest_TriangleMesh(mesh, ray)) return false;
+
+			const Ray objectRay{ mesh.TransformRayToObject(ray) };
+			const SlabRay slabRay{ objectRay };
+
+			if (!TraverseTriangleMesh(mesh, objectRay, slabRay, hitRecord)) return false;
+
+			RecordHit(hitRecord, hitRecord.t, HitObjectType::TriangleMesh, meshIdx);
+			return true;
+		}
+
+		// Packet version: traces the rays of activeMask (bit i = rays[i]) through the mesh hierarchy together
+		// Lanes drop out of a subtree as soon as they miss its box, once a single ray is left it continues on its own
+		inline void HitTest_TriangleMesh(const TriangleMesh& mesh, const uint32_t meshIdx, const RayPacket& packet, HitRecord (&hitRecords)[rayPacketSize], uint32_t activeMask)
+		{
+			if (mesh.geometry->bvh.IsEmpty()) return;
+
+			RenderCounters& counters{ RenderStats::GetThreadCounters() };
+
+			for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+			{
+				if (!(activeMask & (1u << lane))) continue;
+
+				++counters.boxTests;
+				if (!GeometryUtils::SlabTest_TriangleMesh(mesh, packet.rays[lane])) activeMask &= ~(1u << lane);
+			}
+			if (activeMask == 0) return;
+
+			// a lone ray gains nothing from the packet (its box test is already done and counted)
+			if ((activeMask & (activeMask - 1)) == 0)
+			{
+				const uint32_t lane{ GetFirstLane(activeMask) };
+				const Ray objectRay{ mesh.TransformRayToObject(packet.rays[lane]) };
+				const SlabRay slabRay{ objectRay };
+
+				if (TraverseTriangleMesh(mesh, objectRay, slabRay, hitRecords[lane]))
+				{
+					RecordHit(hitRecords[lane], hitRecords[lane].t, HitObjectType::TriangleMesh, meshIdx);
+				}
+				return;
+			}
 
-					case TriangleCullMode::FrontFaceCulling:
-						if (!(tempDot > 0.f)) continue;
-						break;
+			RayPacket objectPacket;
+			for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+			{
+				objectPacket.rays[lane] = mesh.TransformRayToObject(packet.rays[lane]);
+			}
+			const SlabRayPacket slabPacket{ objectPacket };
+
+			const BVH& bvh{ mesh.geometry->bvh };
+			uint32_t hitMask{};
+
+			float maxDistances[rayPacketSize];
+			for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+			{
+				maxDistances[lane] = hitRecords[lane].t;
+			}
+
+			// entry.distance is unused here, the lane masks get culled against maxDistances when a child is tested
+			WideTraversalEntry nodeStack[maxWideStackSize];
+			uint32_t maskStack[maxWideStackSize];
+			size_t stackSize{};
+			nodeStack[stackSize] = { 0, 0, -FLT_MAX };
+			maskStack[stackSize++] = activeMask;
+
+			float laneDistances[rayPacketSize];
+			float childDistances[wideBVHWidth];
+			uint32_t childMasks[wideBVHWidth];
+			uint32_t childSlots[wideBVHWidth];
+
+			while (stackSize > 0)
+			{
+				const WideTraversalEntry entry{ nodeStack[--stackSize] };
+				const uint32_t entryMask{ maskStack[stackSize] };
+
+				// divergence: finish the subtree with the single ray traversal
+				if ((entryMask & (entryMask - 1)) == 0)
+				{
+					const uint32_t lane{ GetFirstLane(entryMask) };
+					const Ray& objectRay{ objectPacket.rays[lane] };
+
+					bool isHit{ false };
+					if (entry.primitiveCount > 0)
+					{
+						counters.triangleTests += entry.primitiveCount;
+						for (uint32_t idx{ entry.child }; idx < entry.child + entry.primitiveCount; ++idx)
+						{
+							if (HitTest_Triangle(mesh, idx, objectRay, hitRecords[lane])) isHit = true;
+						}
+					}
+					else
+					{
+						isHit = TraverseTriangleMesh(mesh, objectRay, SlabRay{ objectRay }, hitRecords[lane], entry.child);
+					}
+
+					if (isHit)
+					{
+						hitMask |= 1u << lane;
+						maxDistances[lane] = hitRecords[lane].t;
+					}
+					continue;
+				}
+
+				if (entry.primitiveCount > 0)
+				{
+					for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+					{
+						if (!(entryMask & (1u << lane))) continue;
+
+						counters.triangleTests += entry.primitiveCount;
+						for (uint32_t idx{ entry.child }; idx < entry.child + entry.primitiveCount; ++idx)
+						{
+							if (HitTest_Triangle(mesh, idx, objectPacket.rays[lane], hitRecords[lane])) hitMask |= 1u << lane;
+						}
+						maxDistances[lane] = hitRecords[lane].t;
 					}
+					continue;
+				}
+
+				// every child box against the packet, near child = the one the closest active ray enters first
+				++counters.nodesVisited;
 
-					const Vector3 V0{ mesh.transformedPositions[mesh.indices[triangleIdx * nrTrianglePoints]] };
+				const WideBVHNode& node{ bvh.wideNodes[entry.child] };
+				uint32_t childMask{};
+				for (uint32_t slot{}; slot < wideBVHWidth; ++slot)
+				{
+					if (node.primitiveCounts[slot] == WideBVHNode::emptyChild) break;
+
+					++counters.boxTests;
+
+					const Vector3 minAABB{ node.minX[slot], node.minY[slot], node.minZ[slot] };
+					const Vector3 maxAABB{ node.maxX[slot], node.maxY[slot], node.maxZ[slot] };
+					childMasks[slot] = SlabTest_AABB(minAABB, maxAABB, slabPacket, maxDistances, laneDistances) & entryMask;
+					if (childMasks[slot] == 0) continue;
+
+					childDistances[slot] = GetClosestDistance(laneDistances, childMasks[slot]);
+					childMask |= 1u << slot;
+				}
+
+				// far to near, so the near child is popped next
+				const uint32_t nrChildren{ SortChildrenFarToNear(childMask, childDistances, childSlots) };
+				for (uint32_t childIdx{}; childIdx < nrChildren; ++childIdx)
+				{
+					const uint32_t slot{ childSlots[childIdx] };
+					nodeStack[stackSize] = { node.children[slot], node.primitiveCounts[slot], childDistances[slot] };
+					maskStack[stackSize++] = childMasks[slot];
+				}
+			}
+
+			for (uint32_t lane{}; lane < rayPacketSize; ++lane)
+			{
+				if (hitMask & (1u << lane)) RecordHit(hitRecords[lane], hitRecords[lane].t, HitObjectType::TriangleMesh, meshIdx);
+			}
+		}
+
+		// Any hit query (shadow rays): stops at the first triangle that blocks the ray
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
+		{
+			const BVH& bvh{ mesh.geometry->bvh };
+			if (bvh.IsEmpty()) return false;
 
-					const float t{ Vector3::Dot((V0 - ray.origin), normal) / tempDot };
+			RenderCounters& counters{ RenderStats::GetThreadCounters() };
 
-					if (!(t <= ray.min || t >= ray.max))
+			++counters.boxTests;
+			if (!GeometryUtils::SlabTest_TriangleMesh(mesh, ray)) return false;
+
+			const Ray objectRay{ mesh.TransformRayToObject(ray) };
+			const SlabRay slabRay{ objectRay };
+			HitRecord ignoredHitRecord{};
+
+			// no ordering, any blocker will do
+			WideTraversalEntry nodeStack[maxWideStackSize];
+			size_t stackSize{};
+			nodeStack[stackSize++] = { 0, 0, -FLT_MAX };
+
+			float childDistances[wideBVHWidth];
+
+			while (stackSize > 0)
+			{
+				const WideTraversalEntry entry{ nodeStack[--stackSize] };
+
+				if (entry.primitiveCount > 0)
+				{
+					for (uint32_t idx{ entry.child }; idx < entry.child + entry.primitiveCount; ++idx)
 					{
-						const Vector3 V1{ mesh.transformedPositions[mesh.indices[triangleIdx * nrTrianglePoints + 1]] };
-						const Vector3 V2{ mesh.transformedPositions[mesh.indices[triangleIdx * nrTrianglePoints + 2]] };
-
-						const Vector3 hitOrigin{ ray.direction * t + ray.origin };
-
-						if (
-							(Vector3::Dot(Vector3::Cross(V1 - V0, hitOrigin - V0), normal) < 0.f) ||
-							(Vector3::Dot(Vector3::Cross(V2 - V1, hitOrigin - V1), normal) < 0.f) ||
-							(Vector3::Dot(Vector3::Cross(V0 - V2, hitOrigin - V2), normal) < 0.f)
-							) continue;
-
-						if (t < hitRecord.t)
-							{
-								hitRecord.didHit = true;
-								hitRecord.t = t;
-								hitRecord.origin = hitOrigin;
-								hitRecord.materialIndex = mesh.materialIndex;
-								hitRecord.normal = normal;
-							}
-						returnValue = true;
+						++counters.triangleTests;
+						if (HitTest_Triangle(mesh, idx, objectRay, ignoredHitRecord, true)) return true;
 					}
+					continue;
+				}
+
+				++counters.nodesVisited;
+				counters.boxTests += wideBVHWidth;
+
+				const WideBVHNode& node{ bvh.wideNodes[entry.child] };
+				const uint32_t childMask{ SlabTest_WideBVHNode(node, slabRay, objectRay.max, childDistances) };
+				for (uint32_t slot{}; slot < wideBVHWidth; ++slot)
+				{
+					if (childMask & (1u << slot)) nodeStack[stackSize++] = { node.children[slot], node.primitiveCounts[slot], childDistances[slot] };
 				}
 			}
 
-			return returnValue;
+			return false;
 		}
 #pragma endregion
 	}
@@ -262,79 +1037,4 @@ namespace dae
 			}
 		}
 	}
-
-	namespace Utils
-	{
-		//Just parses vertices and indices
-#pragma warning(push)
-#pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
-		{
-			std::ifstream file(filename);
-			if (!file)
-				return false;
-
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					float i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					indices.push_back((int)i0 - 1);
-					indices.push_back((int)i1 - 1);
-					indices.push_back((int)i2 - 1);
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof()) 
-					break;
-			}
-
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
-			{
-				const uint32_t i0 = indices[index];
-				const uint32_t i1 = indices[index + 1];
-				const uint32_t i2 = indices[index + 2];
-
-				const Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				const Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal{ Vector3::Cross(edgeV0V1, edgeV0V2) };
-
-				if(isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.emplace_back(normal);
-			}
-
-			return true;
-		}
-#pragma warning(pop)
-	}
-}
\ No newline at end of file
+}
@@ -1,4 +1,8 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+
+#include <algorithm>
 
 namespace dae
 {
@@ -53,6 +57,160 @@ namespace dae
 		static const Vector3 Zero;
 	};
 
+#pragma region Inline Implementations
+	// hot path of every intersection test, kept in the header so it inlines into GeometryUtils/BRDF/Renderer
+	inline Vector3::Vector3(const float _x, const float _y, const float _z) : x(_x), y(_y), z(_z)
+	{
+	}
+
+	inline Vector3::Vector3(const Vector3& from, const Vector3& to) : x(to.x - from.x), y(to.y - from.y), z(to.z - from.z)
+	{
+	}
+
+	inline const float Vector3::Magnitude() const
+	{
+		return sqrtf(x * x + y * y + z * z);
+	}
+
+	inline const float Vector3::SqrMagnitude() const
+	{
+		return x * x + y * y + z * z;
+	}
+
+	inline const float Vector3::Normalize()
+	{
+		const float m = Magnitude();
+		const float invM{ 1.f / m };
+		x *= invM;
+		y *= invM;
+		z *= invM;
+
+		return m;
+	}
+
+	inline const Vector3 Vector3::Normalized() const
+	{
+		const float invM{ 1.f / Magnitude() };
+		return { x * invM, y * invM, z * invM };
+	}
+
+	inline const float Vector3::Dot(const Vector3& v1, const Vector3& v2)
+	{
+		return { v1.x * v2.x + v1.y * v2.y + v1.z * v2.z };
+	}
+
+	inline const Vector3 Vector3::Cross(const Vector3& v1, const Vector3& v2)
+	{
+		return { v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x };
+	}
+
+	inline const Vector3 Vector3::Project(const Vector3& v1, const Vector3& v2)
+	{
+		return { v2 * Dot(v1, v2) / Dot(v2, v2) };
+	}
+
+	inline const Vector3 Vector3::Reject(const Vector3& v1, const Vector3& v2)
+	{
+		return { v1 - v2 * Dot(v1, v2) / Dot(v2, v2) };
+	}
+
+	inline const Vector3 Vector3::Reflect(const Vector3& v1, const Vector3& v2)
+	{
+		return { v1 - v2 * (2.f * Dot(v1, v2)) };
+	}
+
+	inline const Vector3 Vector3::Min(const Vector3& v1, const Vector3& v2)
+	{
+		return
+		{
+			std::min(v1.x, v2.x),
+			std::min(v1.y, v2.y),
+			std::min(v1.z, v2.z)
+		};
+	}
+
+	inline const Vector3 Vector3::Max(const Vector3& v1, const Vector3& v2)
+	{
+		return
+		{
+			std::max(v1.x, v2.x),
+			std::max(v1.y, v2.y),
+			std::max(v1.z, v2.z)
+		};
+	}
+
+	inline const Vector3 Vector3::operator*(float scale) const
+	{
+		return { x * scale, y * scale, z * scale };
+	}
+
+	inline const Vector3 Vector3::operator/(float scale) const
+	{
+		const float invScale{ 1.f / scale };
+		return { x * invScale, y * invScale, z * invScale };
+	}
+
+	inline const Vector3 Vector3::operator+(const Vector3& v) const
+	{
+		return { x + v.x, y + v.y, z + v.z };
+	}
+
+	inline const Vector3 Vector3::operator-(const Vector3& v) const
+	{
+		return { x - v.x, y - v.y, z - v.z };
+	}
+
+	inline const Vector3 Vector3::operator-() const
+	{
+		return { -x , -y, -z };
+	}
+
+	inline Vector3& Vector3::operator*=(float scale)
+	{
+		x *= scale;
+		y *= scale;
+		z *= scale;
+		return *this;
+	}
+
+	inline Vector3& Vector3::operator/=(float scale)
+	{
+		const float invScale{ 1.f / scale };
+		x *= invScale;
+		y *= invScale;
+		z *= invScale;
+		return *this;
+	}
+
+	inline Vector3& Vector3::operator-=(const Vector3& v)
+	{
+		x -= v.x;
+		y -= v.y;
+		z -= v.z;
+		return *this;
+	}
+
+	inline Vector3& Vector3::operator+=(const Vector3& v)
+	{
+		x += v.x;
+		y += v.y;
+		z += v.z;
+		return *this;
+	}
+
+	inline float& Vector3::operator[](int index)
+	{
+		assert(index >= 0 && index < 3);
+		return (index == 0) ? x : (index == 1) ? y : z;
+	}
+
+	inline const float Vector3::operator[](int index) const
+	{
+		assert(index >= 0 && index < 3);
+		return (index == 0) ? x : (index == 1) ? y : z;
+	}
+#pragma endregion
+
 	//Global Operators
 	inline const Vector3 operator*(const float scale, const Vector3& v)
 	{
@@ -8,147 +8,388 @@
 #undef main
 
 //Standard includes
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
 //Project includes
+#include "Benchmark.h"
+#include "MicroBenchmarks.h"
 #include "Timer.h"
 #include "Renderer.h"
 #include "GameScenes.h"
 
 using namespace dae;
 
-int main(/*int argc, char* args[]*/)
+namespace
 {
-	// waarom meegeven als je toch weg doet? //
-	// 
-	//Unreferenced parameters
-	//(void)argc;
-	//(void)args;
+	struct Settings
+	{
+		bool isHeadless{ false };
+		bool showHelp{ false };			// --help/-h: print the usage and quit
+		std::string sceneName{ "reference" };
+		uint32_t width{ 640 };
+		uint32_t height{ 480 };
+		uint32_t nrOfFrames{ 1 };		// headless only, the window keeps rendering until it is closed
+		std::string outputPath{};		// headless only, .bmp of the last frame
+		std::string benchmarkPath{};	// .json or .csv, headless: benchmark the frames, windowed: F6 (default benchmark.json)
+		uint32_t nrOfWarmUpFrames{ 10 };	// benchmark only, rendered before the recorded frames
+		std::string microBenchmarkName{};	// runs that microbenchmark (see MicroBenchmarks::Run) instead of a scene
+	};
 
-	//Create window + surfaces
-	SDL_Init(SDL_INIT_VIDEO);
+	void PrintUsage()
+	{
+		std::cout << "Usage: RayTracer [--help] [--headless] [--scene name] [--width pixels] [--height pixels] [--frames count] [--output file.bmp]\n"
+			<< "                 [--benchmark file.json|file.csv] [--warmup count] [--microbenchmark name]\n"
+			<< "Scenes: w1, w2, w3_test, w3, w4_test, reference, bunny, extra\n";
+		MicroBenchmarks::PrintNames();
+	}
 
-	constexpr uint32_t width{ 640 };
-	constexpr uint32_t height{ 480 };
+	Scene* CreateScene(const std::string& sceneName)
+	{
+		if (sceneName == "w1") return new Scene_W1{};
+		if (sceneName == "w2") return new Scene_W2{};
+		if (sceneName == "w3_test") return new Scene_W3_TestScene{};
+		if (sceneName == "w3") return new Scene_W3{};
+		if (sceneName == "w4_test") return new Scene_W4_TestScene{};
+		if (sceneName == "reference") return new Scene_W4_ReferenceScene{};
+		if (sceneName == "bunny") return new Scene_W4_BunnyScene{};
+		if (sceneName == "extra") return new Scene_W4_Extra{};
+		return nullptr;
+	}
 
-	SDL_Window* pWindow
+	bool ParseArguments(int argc, char* args[], Settings& settings)
 	{
-		SDL_CreateWindow(
-			"RayTracer - **Maurice Vandenheede(2DAE18N)**",
-			SDL_WINDOWPOS_UNDEFINED,
-			SDL_WINDOWPOS_UNDEFINED,
-			width, height, 0)
-	};
+		for (int argIdx{ 1 }; argIdx < argc; ++argIdx)
+		{
+			const std::string argument{ args[argIdx] };
+
+			if (argument == "--help" || argument == "-h")
+			{
+				settings.showHelp = true;
+				return true;
+			}
+
+			if (argument == "--headless")
+			{
+				settings.isHeadless = true;
+				continue;
+			}
+
+			// every other option takes a value, unknown ones are reported before asking for it
+			const bool isValueOption
+			{
+				argument == "--scene" || argument == "--output" || argument == "--width" || argument == "--height"
+				|| argument == "--frames" || argument == "--benchmark" || argument == "--warmup" || argument == "--microbenchmark"
+			};
+			if (!isValueOption)
+			{
+				std::cout << "Unknown option " << argument << "\n";
+				return false;
+			}
+
+			if (argIdx + 1 >= argc)
+			{
+				std::cout << "Missing value for " << argument << "\n";
+				return false;
+			}
+			const char* value{ args[++argIdx] };
+
+			if (argument == "--scene") settings.sceneName = value;
+			else if (argument == "--output") settings.outputPath = value;
+			else if (argument == "--width") settings.width = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			else if (argument == "--height") settings.height = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			else if (argument == "--frames") settings.nrOfFrames = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			else if (argument == "--benchmark") settings.benchmarkPath = value;
+			else if (argument == "--warmup") settings.nrOfWarmUpFrames = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			else if (argument == "--microbenchmark") settings.microBenchmarkName = value;
+		}
+
+		if (settings.width == 0 || settings.height == 0 || settings.nrOfFrames == 0)
+		{
+			std::cout << "Width, height and frames must be bigger than 0\n";
+			return false;
+		}
+		return true;
+	}
 
-	if (!pWindow) return 1;
+	// Loads the scene on the renderer's workers and reports what the loading cost
+	void InitializeScene(Scene* pScene, Renderer* pRenderer)
+	{
+		const auto startTime{ std::chrono::steady_clock::now() };
+		pScene->Initialize(pRenderer->GetThreadPool());
+		const auto endTime{ std::chrono::steady_clock::now() };
+
+		std::cout << "Scene loaded in " << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms"
+			<< " (mesh BVH builds: " << pScene->GetMeshBVHBuildTime() << " ms)\n";
+	}
+
+	Benchmark* CreateBenchmark(const Settings& settings, const Renderer* pRenderer, const uint32_t nrOfFrames)
+	{
+		BenchmarkSettings benchmarkSettings{};
+		benchmarkSettings.sceneName = settings.sceneName;
+		benchmarkSettings.width = settings.width;
+		benchmarkSettings.height = settings.height;
+		benchmarkSettings.nrOfThreads = pRenderer->GetNrOfWorkers();
+		benchmarkSettings.nrOfWarmUpFrames = settings.nrOfWarmUpFrames;
+		benchmarkSettings.nrOfFrames = nrOfFrames;
+
+		return new Benchmark{ benchmarkSettings };
+	}
+
+	void FinishBenchmark(const Benchmark* pBenchmark, const std::string& filePath)
+	{
+		pBenchmark->PrintResults();
+
+		if (pBenchmark->SaveResults(filePath)) std::cout << "Something went wrong. " << filePath << " not saved!\n";
+		else std::cout << "Saved " << filePath << "\n";
+	}
+
+	// Batch/benchmark runs: no window, no presenting, only the frames (and optionally the last one saved)
+	int RunHeadless(const Settings& settings, Scene* pScene)
+	{
+		Timer* pTimer = new Timer{};
+		Renderer* pRenderer = new Renderer{ static_cast<int>(settings.width), static_cast<int>(settings.height) };
+
+		InitializeScene(pScene, pRenderer);
 
-	//Initialize "framework"
-	Timer* pTimer = new Timer{};
-	Renderer* pRenderer = new Renderer{ pWindow, width, height };
+		pTimer->Start();
 
-	//Scene_W1* pScene{ new Scene_W1{} };
-	//Scene_W2* pScene{ new Scene_W2{} };
-	//Scene_W3_TestScene* pScene{ new Scene_W3_TestScene{} };
-	//Scene_W3* pScene{ new Scene_W3{} };
-	//Scene_W4_TestScene* pScene{ new Scene_W4_TestScene{} };
-	Scene_W4_ReferenceScene* pScene{ new Scene_W4_ReferenceScene{} };
-	//Scene_W4_BunnyScene* pScene{ new Scene_W4_BunnyScene{} };
-	//Scene_W4_Extra* pScene{ new Scene_W4_Extra{} };
-	pScene->Initialize();
+		// benchmarks render their warm-up frames on top of the requested ones
+		Benchmark* pBenchmark{ settings.benchmarkPath.empty() ? nullptr : CreateBenchmark(settings, pRenderer, settings.nrOfFrames) };
+		const uint32_t nrOfFrames{ pBenchmark ? settings.nrOfWarmUpFrames + settings.nrOfFrames : settings.nrOfFrames };
 
-	//Start loop
-	pTimer->Start();
+		FrameStats totalStats{};
+
+		const auto startTime{ std::chrono::steady_clock::now() };
+		for (uint32_t frameIdx{}; frameIdx < nrOfFrames; ++frameIdx)
+		{
+			pScene->Update(pTimer);
+			pRenderer->Render(pScene);
+			pTimer->Update();
+
+			totalStats += pRenderer->GetFrameStats();
+			if (pBenchmark) pBenchmark->AddFrame(pRenderer->GetFrameStats());
+		}
+		const auto endTime{ std::chrono::steady_clock::now() };
+
+		pTimer->Stop();
+
+		const double totalMs{ std::chrono::duration<double, std::milli>(endTime - startTime).count() };
+		std::cout << settings.sceneName << " " << settings.width << "x" << settings.height << ": "
+			<< nrOfFrames << " frames, " << totalMs / nrOfFrames << " ms/frame\n";
+		totalStats.Print();
+
+		if (pBenchmark)
+		{
+			FinishBenchmark(pBenchmark, settings.benchmarkPath);
+			delete pBenchmark;
+		}
+
+		int returnValue{ 0 };
+		if (!settings.outputPath.empty())
+		{
+			if (pRenderer->SaveBufferToImage(settings.outputPath.c_str()))
+			{
+				std::cout << "Something went wrong. " << settings.outputPath << " not saved!\n";
+				returnValue = 1;
+			}
+			else
+			{
+				std::cout << "Saved " << settings.outputPath << "\n";
+			}
+		}
 
-	float printTimer{};
-	bool showFPS{ true };
-	bool isLooping{ true };
-	bool takeScreenshot{ false };
+		delete pRenderer;
+		delete pTimer;
 
-	SDL_Event e{};
+		return returnValue;
+	}
 
-	while (isLooping)
+	int RunWindowed(const Settings& settings, Scene* pScene)
 	{
-		//--------- Get input events ---------//
-		while (SDL_PollEvent(&e))
+		//Create window + surfaces
+		SDL_Init(SDL_INIT_VIDEO);
+
+		const uint32_t width{ settings.width };
+		const uint32_t height{ settings.height };
+
+		SDL_Window* pWindow
 		{
-			switch (e.type)
+			SDL_CreateWindow(
+				"RayTracer - **Maurice Vandenheede(2DAE18N)**",
+				SDL_WINDOWPOS_UNDEFINED,
+				SDL_WINDOWPOS_UNDEFINED,
+				width, height, 0)
+		};
+
+		if (!pWindow)
+		{
+			SDL_Quit();
+			return 1;
+		}
+
+		//Initialize "framework"
+		Timer* pTimer = new Timer{};
+		Renderer* pRenderer = new Renderer{ pWindow, static_cast<int>(width), static_cast<int>(height) };
+
+		InitializeScene(pScene, pRenderer);
+
+		//Start loop
+		pTimer->Start();
+
+		Benchmark* pBenchmark{};
+		const std::string benchmarkPath{ settings.benchmarkPath.empty() ? "benchmark.json" : settings.benchmarkPath };
+
+		float printTimer{};
+		bool showFPS{ true };
+		bool isLooping{ true };
+		bool takeScreenshot{ false };
+
+		SDL_Event e{};
+
+		while (isLooping)
+		{
+			//--------- Get input events ---------//
+			while (SDL_PollEvent(&e))
 			{
-			case SDL_QUIT:
-				isLooping = false;
-				break;
-			case SDL_KEYUP:
-				switch (e.key.keysym.scancode)
+				switch (e.type)
 				{
-				case SDL_SCANCODE_X:
-					takeScreenshot = true;
+				case SDL_QUIT:
+					isLooping = false;
 					break;
+				case SDL_KEYUP:
+					switch (e.key.keysym.scancode)
+					{
+					case SDL_SCANCODE_X:
+						takeScreenshot = true;
+						break;
 
-				case SDL_SCANCODE_F2:
-					pRenderer->ToggleShadows();
-					break;
+					case SDL_SCANCODE_F2:
+						pRenderer->ToggleShadows();
+						break;
 
-				case SDL_SCANCODE_F3:
-					pRenderer->CycleLightingMode();
-					break;
+					case SDL_SCANCODE_F3:
+						pRenderer->CycleLightingMode();
+						break;
 
-				case SDL_SCANCODE_F6:
-					pTimer->StartBenchmark();
-					break;
+					case SDL_SCANCODE_F4:
+						pRenderer->ToggleAccumulation();
+						break;
 
-				case SDL_SCANCODE_F:
-					showFPS = !showFPS;
-					break;
+					case SDL_SCANCODE_F6:
+						if (pBenchmark)
+						{
+							std::cout << "(Benchmark already running)\n";
+							break;
+						}
+						pBenchmark = CreateBenchmark(settings, pRenderer, 100);
+						std::cout << "**BENCHMARK STARTED**\n";
+						break;
+
+					case SDL_SCANCODE_F:
+						showFPS = !showFPS;
+						break;
 
-				default:
+					default:
+						break;
+					}
 					break;
 				}
-				break;
 			}
-		}
 
-		//--------- Update ---------//
-		pScene->Update(pTimer);
+			//--------- Update ---------//
+			pScene->Update(pTimer);
 
-		//--------- Render ---------//
-		pRenderer->Render(pScene);
+			//--------- Render ---------//
+			pRenderer->Render(pScene);
 
-		//--------- Timer ---------//
-		pTimer->Update();
+			//--------- Timer ---------//
+			pTimer->Update();
 
-		// fps
-		if (showFPS)
-		{
-			printTimer += pTimer->GetElapsed();
-			if (printTimer >= 1.f)
+			if (pBenchmark && pBenchmark->AddFrame(pRenderer->GetFrameStats()))
 			{
-				printTimer = 0.f;
-				std::cout << "dFPS: " << pTimer->GetdFPS() << "\n";
+				FinishBenchmark(pBenchmark, benchmarkPath);
+				delete pBenchmark;
+				pBenchmark = nullptr;
 			}
-		}
 
-		// screenShot
-		if (takeScreenshot)
-		{
-			takeScreenshot = false;
-			if (pRenderer->SaveBufferToImage())
+			// fps
+			if (showFPS)
 			{
-				std::cout << "Something went wrong. Screenshot not saved!" << "\n";	
+				printTimer += pTimer->GetElapsed();
+				if (printTimer >= 1.f)
+				{
+					printTimer = 0.f;
+					std::cout << "dFPS: " << pTimer->GetdFPS() << "\n";
+					pRenderer->GetFrameStats().Print();
+				}
 			}
-			else
+
+			// screenShot
+			if (takeScreenshot)
 			{
-				std::cout << "Screenshot saved!" << "\n";
+				takeScreenshot = false;
+				if (pRenderer->SaveBufferToImage())
+				{
+					std::cout << "Something went wrong. Screenshot not saved!" << "\n";	
+				}
+				else
+				{
+					std::cout << "Screenshot saved!" << "\n";
+				}
 			}
 		}
+		pTimer->Stop();
+
+		//Shutdown "framework"
+		delete pBenchmark;
+		delete pRenderer;
+		delete pTimer;
+
+		SDL_DestroyWindow(pWindow);
+		SDL_Quit();
+
+		return 0;
 	}
-	pTimer->Stop();
+}
 
-	//Shutdown "framework"
-	delete pScene;
-	delete pRenderer;
-	delete pTimer;
+int main(int argc, char* args[])
+{
+	Settings settings{};
+	if (!ParseArguments(argc, args, settings))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (settings.showHelp)
+	{
+		PrintUsage();
+		return 0;
+	}
 
-	SDL_DestroyWindow(pWindow);
-	SDL_Quit();
+	if (!settings.microBenchmarkName.empty())
+	{
+		if (MicroBenchmarks::Run(settings.microBenchmarkName)) return 0;
+
+		std::cout << "Unknown microbenchmark " << settings.microBenchmarkName << "\n";
+		PrintUsage();
+		return 1;
+	}
+
+	Scene* pScene{ CreateScene(settings.sceneName) };
+	if (!pScene)
+	{
+		std::cout << "Unknown scene " << settings.sceneName << "\n";
+		PrintUsage();
+		return 1;
+	}
+
+	const int returnValue{ settings.isHeadless ? RunHeadless(settings, pScene) : RunWindowed(settings, pScene) };
+
+	delete pScene;
 
-	return 0;
-}
\ No newline at end of file
+	return returnValue;
+}